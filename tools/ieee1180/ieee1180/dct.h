@@ -18,3 +18,8 @@ typedef long INT32;		/* must be at least 32 bits */
 
 extern void j_fwd_dct();
 extern void j_rev_dct();
+
+#ifdef MPEG2DEC			/* mpeg2idct.c */
+extern int idct_versions_differ();
+extern char *idct_versions();
+#endif
@@ -0,0 +1,149 @@
+/*
+ * mpeg2idct.c --- the IDCT of mpeg2decode (../../mpeg2dec/idct.c) as the
+ * test IDCT of ieeetest, built by "make mpeg2test".
+ *
+ * j_rev_dct() uses the version mpeg2decode picks on this CPU. Each block
+ * is also given to every other version this CPU can run, which must
+ * produce exactly the same result as the C version. So must the kernels
+ * for sparse blocks, tried on the DC coefficient, row 0, column 0 and the
+ * 4x4 low frequencies of the block, with and without the F[7][7] that
+ * mismatch control may add, and Sparse_IDCT_Macroblock(), which may
+ * transform two blocks at once, on each of these together with the whole
+ * block.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dct.h"
+
+/* idct.c */
+void Initialize_Fast_IDCT(void);
+char *Select_Fast_IDCT(char *name);
+void Fast_IDCT(short *block);
+void Sparse_IDCT(short *block, int rows, int cols);
+void Sparse_IDCT_Macroblock(short *block[], int rows[], int cols[], int n);
+
+static char *versions[] = {"c", "sse2", "avx2", "neon"};
+#define NVERSIONS (sizeof(versions)/sizeof(versions[0]))
+
+static char *best;		/* what mpeg2decode uses */
+
+
+static void init (void)
+{
+  if (best == NULL) {
+    Initialize_Fast_IDCT();
+    best = Select_Fast_IDCT(NULL);
+  }
+}
+
+
+void j_rev_dct (DCTELEM *data)
+{
+  init();
+  Fast_IDCT(data);
+}
+
+
+/* the coefficients of coefs in the rows of rowmask and the columns of
+   colmask, with the rows and columns that hold any for Sparse_IDCT() */
+static void sparse (DCTELEM *coefs, DCTELEM *block, int rowmask, int colmask,
+		    int *rows, int *cols)
+{
+  int i;
+
+  *rows = *cols = 0;
+  for (i = 0; i < DCTSIZE2; i++) {
+    block[i] = ((rowmask >> (i/8)) & (colmask >> (i%8)) & 1) ? coefs[i] : 0;
+    if (block[i]) {
+      *rows |= 1 << (i/8);
+      *cols |= 1 << (i%8);
+    }
+  }
+}
+
+
+/* 1 if any version gives a result different from the C version */
+int idct_versions_differ (DCTELEM *coefs)
+{
+  static int masks[][2] = {	/* rows, columns */
+    {0xff, 0xff}, {0x01, 0x01}, {0x01, 0xff}, {0xff, 0x01}, {0x0f, 0x0f}
+  };
+  DCTELEM in[DCTSIZE2], ref[DCTSIZE2], out[DCTSIZE2];
+  DCTELEM full[DCTSIZE2], out2[DCTSIZE2];
+  short *pair[2];
+  int i, m, f77, rows, cols, differ = 0;
+  int pair_rows[2], pair_cols[2];
+
+  init();
+
+  memcpy(full, coefs, sizeof(full));
+  Select_Fast_IDCT("c");
+  Fast_IDCT(full);
+
+  for (m = 0; m < sizeof(masks)/sizeof(masks[0]); m++)
+    for (f77 = 0; f77 < 2; f77++) {
+      sparse(coefs, in, masks[m][0], masks[m][1], &rows, &cols);
+      if (f77)			/* not in rows and cols */
+	in[63] ^= 1;
+
+      memcpy(ref, in, sizeof(ref));
+      Select_Fast_IDCT("c");
+      Fast_IDCT(ref);
+
+      for (i = 0; i < NVERSIONS; i++) {
+	if (Select_Fast_IDCT(versions[i]) == NULL)
+	  continue;
+	if (i > 0) {
+	  memcpy(out, in, sizeof(out));
+	  Fast_IDCT(out);
+	  if (memcmp(out, ref, sizeof(out)) != 0)
+	    differ = 1;
+	}
+	memcpy(out, in, sizeof(out));
+	Sparse_IDCT(out, rows, cols);
+	if (memcmp(out, ref, sizeof(out)) != 0)
+	  differ = 1;
+
+	memcpy(out, in, sizeof(out));
+	memcpy(out2, coefs, sizeof(out2));
+	pair[0] = out;
+	pair[1] = out2;
+	pair_rows[0] = rows;
+	pair_cols[0] = cols;
+	pair_rows[1] = pair_cols[1] = 0xff;
+	Sparse_IDCT_Macroblock(pair, pair_rows, pair_cols, 2);
+	if (memcmp(out, ref, sizeof(out)) != 0 ||
+	    memcmp(out2, full, sizeof(out2)) != 0)
+	  differ = 1;
+      }
+    }
+
+  Select_Fast_IDCT(best);
+  return differ;
+}
+
+
+/* the versions idct_versions_differ() runs, and the one j_rev_dct() uses */
+char *idct_versions (void)
+{
+  static char names[80];
+  int i;
+
+  init();
+
+  names[0] = '\0';
+  for (i = 0; i < NVERSIONS; i++) {
+    if (Select_Fast_IDCT(versions[i]) == NULL)
+      continue;
+    strcat(names, versions[i]);
+    strcat(names, " ");
+  }
+  Select_Fast_IDCT(best);
+
+  strcat(names, "(testing ");
+  strcat(names, best);
+  strcat(names, ")");
+  return names;
+}
@@ -36,6 +36,49 @@
 #define _ANSI_ARGS_(x) x
 #endif
 
+/* small functions defined in headers (getbits.h) */
+#ifdef __GNUC__
+#define INLINE static __inline__
+#else
+#define INLINE static
+#endif
+
+/* functions that are specialized by calling them with constant
+   arguments (getblk.c) */
+#ifdef __GNUC__
+#define ALWAYS_INLINE static __inline__ __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE static
+#endif
+
+/* buffers the SIMD kernels work on, aligned to their vector size
+   (getpic.c) */
+#ifdef __GNUC__
+#define ALIGNED(n) __attribute__((aligned(n)))
+#else
+#define ALIGNED(n)
+#endif
+
+/* decoder state that each decoding thread has a copy of (multi.c) */
+#if defined(HAVE_PTHREAD) && defined(__GNUC__)
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL
+#endif
+
+/* SIMD versions of inner loops (idct.c, recon.c): x86 code for
+   instruction set extensions the compiler is not told to assume, used if
+   the CPU has them, and NEON wherever the compiler targets it */
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || \
+    (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define HAVE_X86_SIMD
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define HAVE_NEON
+#endif
+
 #define RB "rb"
 #define WB "wb"
 
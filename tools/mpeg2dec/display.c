@@ -374,23 +374,25 @@ do_display(unsigned char *src[])
     py = src[0];
     dst = ImageData;
     if (bpp == 8) 	/* for speed on 8bpp we do grayscale */
-	memcpy(dst, py, Coded_Picture_Height*Coded_Picture_Width);
+	for (y = 0; y < Coded_Picture_Height; y++)
+	    memcpy(dst + y * Coded_Picture_Width, py + y * Coded_Picture_Stride,
+		Coded_Picture_Width);
     else {
 	if (chroma_format==CHROMA444 || !hiQdither) {
 		pv = src[1];
 		pu = src[2];
 	} else {
 	    if (!u444) {
-		if (!(u422=(unsigned char *)malloc((Coded_Picture_Width>>1)*
+		if (!(u422=(unsigned char *)malloc((Coded_Picture_Stride>>1)*
 		    Coded_Picture_Height)))
 		    Error("malloc failed");
-		if (!(v422=(unsigned char *)malloc((Coded_Picture_Width>>1)*
+		if (!(v422=(unsigned char *)malloc((Coded_Picture_Stride>>1)*
 		    Coded_Picture_Height)))
 		    Error("malloc failed");
-		if (!(u444=(unsigned char *)malloc(Coded_Picture_Width*
+		if (!(u444=(unsigned char *)malloc(Coded_Picture_Stride*
 		    Coded_Picture_Height)))
 		    Error("malloc failed");
-		if (!(v444=(unsigned char *)malloc(Coded_Picture_Width*
+		if (!(v444=(unsigned char *)malloc(Coded_Picture_Stride*
 		    Coded_Picture_Height)))
 		    Error("malloc failed");
 	    }
@@ -408,18 +410,16 @@ do_display(unsigned char *src[])
 	}
 	for (y = 0; y < Coded_Picture_Height; y++) 
 	    for (x = 0; x < Coded_Picture_Width; x++) {
-		Y = 76309 * ((*py++) - 16);
+		Y = 76309 * (py[y * Coded_Picture_Stride + x] - 16);
 		if (!hiQdither && chroma_format!=CHROMA444) {
 		    if (chroma_format==CHROMA422)
-			pixel = y * Chroma_Width + (x>>1);
+			pixel = y * Chroma_Stride + (x>>1);
 		    else	/* 420 */
-			pixel = (y>>1) * Chroma_Width + (x>>1);
-		    U = pu[pixel] - 128;
-		    V = pv[pixel] - 128;
-		} else {
-		    U = (*pu++) - 128;
-		    V = (*pv++) - 128;
-		}
+			pixel = (y>>1) * Chroma_Stride + (x>>1);
+		} else
+		    pixel = y * Coded_Picture_Stride + x;
+		U = pu[pixel] - 128;
+		V = pv[pixel] - 128;
 		r = Clip[(Y+crv*V)>>16];
 		g = Clip[(Y-cgu*U-cgv*V + 32768)>>16];
 		b = Clip[(Y+cbu*U + 32768)>>16];
@@ -34,18 +34,194 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef HAVE_MMAP
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
 
 #include "config.h"
 #include "global.h"
 
+/* endless run of sequence end codes, preceded by up to four zero bytes
+ * for word alignment; shared by all layers and never written after
+ * Initialize_Buffer() set it up
+ */
+static unsigned char Padbfr[4+2048];
+
+/* open a bitstream file for the current layer
+ * regular files are memory mapped when compiled with HAVE_MMAP, so that
+ * Rdptr walks the file itself; pipes, devices and everything mmap()
+ * refuses are read() into Rdbfr[] in 2048 byte blocks, or into the
+ * read-ahead ring once Start_Readahead() has been called; stdin and
+ * sockets are opened by Open_Live_Input() (live.c)
+ */
+int Open_Bitstream(Filename)
+char *Filename;
+{
+  int Infile;
+#ifdef HAVE_MMAP
+  struct stat st;
+  void *map;
+#endif
+
+  ld->Mapbase = NULL;
+  ld->Mapsize = 0;
+  ld->Ring = NULL;
+  ld->Stream_Id = Video_Stream;
+  ld->Pid = Video_Stream;
+  ld->Pmt_Pid = -1;
+  ld->Live = 0;
+
+  if ((Infile = Open_Live_Input(Filename))!=-2)
+    return Infile;
+
+  if ((Infile = open(Filename,O_RDONLY|O_BINARY))<0)
+    return Infile;
+
+#ifdef HAVE_MMAP
+  /* read-ahead (-a) asks for read() on a separate thread instead */
+  if (!Readahead_Buffers && fstat(Infile,&st)==0 && S_ISREG(st.st_mode) && st.st_size>0
+      && (off_t)(size_t)st.st_size==st.st_size)
+  {
+    map = mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_SHARED,Infile,0);
+    if (map!=MAP_FAILED)
+    {
+#ifdef MADV_SEQUENTIAL
+      madvise(map,(size_t)st.st_size,MADV_SEQUENTIAL);
+#endif
+      ld->Mapbase = (unsigned char *)map;
+      ld->Mapsize = (long)st.st_size;
+    }
+  }
+#endif /* HAVE_MMAP */
+
+  return Infile;
+}
+
+void Close_Bitstream()
+{
+#ifdef HAVE_PTHREAD
+  Stop_Readahead();
+#endif /* HAVE_PTHREAD */
+
+#ifdef HAVE_MMAP
+  if (ld->Mapbase!=NULL)
+    munmap(ld->Mapbase,(size_t)ld->Mapsize);
+#endif /* HAVE_MMAP */
+  ld->Mapbase = NULL;
+  ld->Mapsize = 0;
+
+  close(ld->Infile);
+}
+
+/* continue the current layer with sequence end codes,
+ * Zeros bytes of 0 complete the last 32-bit word first
+ * (the caller accounts for Filepos and Rdbase)
+ */
+void Pad_Buffer(Zeros)
+int Zeros;
+{
+  ld->Rdptr = Padbfr + 4 - Zeros;
+  ld->Rdend = Padbfr + sizeof(Padbfr);
+}
+
+/* true while the current layer reads the sequence end codes that
+ * Pad_Buffer() appends at end of file
+ */
+int Bitstream_Padding()
+{
+  return ld->Rdend==Padbfr+sizeof(Padbfr);
+}
+
+/* offset in the input file of p, a position in the current buffer */
+long Bitstream_Offset(p)
+unsigned char *p;
+{
+  return ld->Filepos + (p - ld->Rdbase);
+}
+
+/* continue the current layer at byte Offset of its file, then discard
+ * Skip bytes of video data; for system streams Offset must be the start
+ * of a packet (or pack), for random access from an index (index.c)
+ */
+void Seek_Bitstream(Offset,Skip)
+long Offset;
+int Skip;
+{
+#ifdef HAVE_PTHREAD
+  if (ld->Ring!=NULL)
+  {
+    Stop_Readahead();
+    if (lseek(ld->Infile,Offset,SEEK_SET)<0)
+      Error("unable to seek in bitstream file\n");
+    Start_Readahead(Readahead_Buffers);
+  }
+  else
+#endif /* HAVE_PTHREAD */
+  if (lseek(ld->Infile,Offset,SEEK_SET)<0)
+    Error("unable to seek in bitstream file\n");
+
+  Initialize_Buffer();
+
+  while (Skip-- > 0)
+    Flush_Buffer(8);
+}
+
 /* initialize buffer, call once before first getbits or showbits */
+/* input starts at the current offset of the file, see Seek_Bitstream() */
 
 void Initialize_Buffer()
 {
+  Reset_Buffer();
+  Flush_Buffer(0); /* fills valid data into bfr */
+}
+
+/* Initialize_Buffer() without filling bfr, for reading the input
+   bytewise with Get_Byte() (multi.c) */
+void Reset_Buffer()
+{
+  int l;
+
+  if (Padbfr[7]!=(SEQUENCE_END_CODE&0xff))
+  {
+    for (l=4; l<(int)sizeof(Padbfr); l+=4)
+    {
+      Padbfr[l]   = SEQUENCE_END_CODE>>24;
+      Padbfr[l+1] = SEQUENCE_END_CODE>>16;
+      Padbfr[l+2] = SEQUENCE_END_CODE>>8;
+      Padbfr[l+3] = SEQUENCE_END_CODE&0xff;
+    }
+  }
+
   ld->Incnt = 0;
-  ld->Rdptr = ld->Rdbfr + 2048;
+
+  /* once running, the read-ahead thread owns the file offset;
+     Start_Readahead() has noted it in Filepos */
+  if (ld->Ring==NULL && (ld->Filepos = lseek(ld->Infile,0L,SEEK_CUR)) < 0)
+    ld->Filepos = 0;
+
+  if (ld->Mapbase!=NULL)
+  {
+    ld->Rdptr = ld->Mapbase + ld->Filepos;
+    ld->Rdend = ld->Mapbase + ld->Mapsize;
+  }
+  else
+  {
+    ld->Rdptr = ld->Rdbfr + 2048;
+    ld->Rdend = ld->Rdptr;
+  }
+  ld->Rdbase = ld->Rdptr;
   ld->Rdmax = ld->Rdptr;
 
+  ld->Pktpos = ld->Prevpos = ld->Pktdata = ld->Filepos;
+  ld->Pktbase = ld->Prevbase = 0;
+  ld->Cc = -1;
+  ld->Timestamps = 0;
+
 #ifdef VERIFY
   /*  only the verifier uses this particular bit counter 
    *  Bitcnt keeps track of the current parser position with respect
@@ -56,40 +232,51 @@ void Initialize_Buffer()
 #endif
 
   ld->Bfr = 0;
-  Flush_Buffer(0); /* fills valid data into bfr */
 }
 
+/* called when Rdptr has reached Rdend */
+
 void Fill_Buffer()
 {
   int Buffer_Level;
+  unsigned char *Oldend;
 
-  Buffer_Level = read(ld->Infile,ld->Rdbfr,2048);
-  ld->Rdptr = ld->Rdbfr;
-
-  if (System_Stream_Flag)
-    ld->Rdmax -= 2048;
+  Oldend = ld->Rdend;
 
-  
-  /* end of the bitstream file */
-  if (Buffer_Level < 2048)
+#ifdef HAVE_PTHREAD
+  if (ld->Ring!=NULL)
+    Next_Readahead_Buffer();
+  else
+#endif /* HAVE_PTHREAD */
+  if (ld->Mapbase!=NULL)
   {
-    /* just to be safe */
-    if (Buffer_Level < 0)
-      Buffer_Level = 0;
-
-    /* pad until the next to the next 32-bit word boundary */
-    while (Buffer_Level & 3)
-      ld->Rdbfr[Buffer_Level++] = 0;
+    /* memory mapped: all of the file has been seen, synthesize the
+       sequence end padding of the read() path without copying */
+    Pad_Buffer(Oldend==ld->Mapbase+ld->Mapsize ? (int)(-ld->Mapsize&3) : 0);
+  }
+  else
+  {
+    Buffer_Level = read(ld->Infile,ld->Rdbfr,2048);
 
-	/* pad the buffer with sequence end codes */
-    while (Buffer_Level < 2048)
+    if (Buffer_Level > 0)
     {
-      ld->Rdbfr[Buffer_Level++] = SEQUENCE_END_CODE>>24;
-      ld->Rdbfr[Buffer_Level++] = SEQUENCE_END_CODE>>16;
-      ld->Rdbfr[Buffer_Level++] = SEQUENCE_END_CODE>>8;
-      ld->Rdbfr[Buffer_Level++] = SEQUENCE_END_CODE&0xff;
+      /* pipes may return less than asked for */
+      ld->Rdptr = ld->Rdbfr;
+      ld->Rdend = ld->Rdbfr + Buffer_Level;
+    }
+    else
+    {
+      /* end of the bitstream file: pad until the next 32-bit word
+         boundary, then continue with sequence end codes */
+      Pad_Buffer((int)(-(ld->Filepos + (Oldend - ld->Rdbase))&3));
     }
   }
+
+  ld->Filepos += Oldend - ld->Rdbase;
+  ld->Rdbase = ld->Rdptr;
+
+  if (System_Stream_Flag)
+    ld->Rdmax -= Oldend - ld->Rdptr;
 }
 
 
@@ -97,11 +284,14 @@ void Fill_Buffer()
 
 int Get_Byte()
 {
-  while(ld->Rdptr >= ld->Rdbfr+2048)
+  int Skip;
+
+  while(ld->Rdptr >= ld->Rdend)
   {
-    read(ld->Infile,ld->Rdbfr,2048);
-    ld->Rdptr -= 2048;
-    ld->Rdmax -= 2048;
+    /* keep any skip past the end of the buffer */
+    Skip = ld->Rdptr - ld->Rdend;
+    Fill_Buffer();
+    ld->Rdptr += Skip;
   }
   return *ld->Rdptr++;
 }
@@ -116,87 +306,135 @@ int Get_Word()
 }
 
 
-/* return next n bits (right adjusted) without advancing */
+/* slow path of Flush_Buffer(): refill the bit reservoir byte by byte
+ * across Rdbfr[] refills, system layer packet boundaries and the
+ * sequence end code padding at end of file
+ */
 
-unsigned int Show_Bits(N)
-int N;
+void Refill_Buffer()
 {
-  return ld->Bfr >> (32-N);
-}
+  int Incnt;
 
+  Incnt = ld->Incnt;
 
-/* return next bit (could be made faster than Get_Bits(1)) */
+  if (System_Stream_Flag)
+  {
+    while (Incnt <= 56)
+    {
+      if (ld->Rdptr >= ld->Rdmax)
+        Next_Packet();
+      ld->Bfr |= (unsigned long long)Get_Byte() << (56 - Incnt);
+      Incnt += 8;
+    }
+  }
+  else
+  {
+    while (Incnt <= 56)
+    {
+      if (ld->Rdptr >= ld->Rdend)
+        Fill_Buffer();
+      ld->Bfr |= (unsigned long long)*ld->Rdptr++ << (56 - Incnt);
+      Incnt += 8;
+    }
+  }
 
-unsigned int Get_Bits1()
-{
-  return Get_Bits(1);
+  ld->Incnt = Incnt;
 }
 
 
-/* advance by n bits */
+/* advance to the next byte aligned start code prefix 0x000001
+ *
+ * Instead of testing Show_Bits(24) byte by byte, the bytes still in the
+ * reservoir are checked first and then the input buffer itself is
+ * searched for the 0x01 byte with memchr(), one contiguous run at a time
+ * (up to the end of the buffer and, for system streams, of the packet).
+ * Only the two zero bytes in front of a candidate are tested, carried
+ * across run boundaries in Zeros.  The reservoir is primed once, at the
+ * start code.  Stops at the sequence end code padding at end of file.
+ */
 
-void Flush_Buffer(N)
-int N;
+void Seek_Start_Code()
 {
-  int Incnt;
+  int k, Bytes, Zeros, Skip;
+  long Skipped;
+  unsigned char *p, *q, *Limit;
 
-  ld->Bfr <<= N;
+  /* byte align */
+  Flush_Buffer(ld->Incnt&7);
 
-  Incnt = ld->Incnt -= N;
-
-  if (Incnt <= 24)
+  /* a start code that lies completely within the reservoir */
+  Bytes = ld->Incnt>>3;
+  for (k=0; k<=Bytes-3; k++)
   {
-    if (System_Stream_Flag && (ld->Rdptr >= ld->Rdmax-4))
+    if (((ld->Bfr>>(40-8*k)) & 0xffffff)==0x01)
     {
-      do
+      if (k>4)
       {
-        if (ld->Rdptr >= ld->Rdmax)
-          Next_Packet();
-        ld->Bfr |= Get_Byte() << (24 - Incnt);
-        Incnt += 8;
+        Flush_Buffer(32);
+        k -= 4;
       }
-      while (Incnt <= 24);
+      Flush_Buffer(8*k);
+      return;
     }
-    else if (ld->Rdptr < ld->Rdbfr+2044)
+  }
+
+  /* drop the reservoir, except for the count of trailing zero bytes */
+  Zeros = 0;
+  while (Zeros<2 && ((ld->Bfr>>(64-8*(Bytes-Zeros))) & 0xff)==0)
+    Zeros++;
+  Skipped = Bytes;
+
+  for (;;)
+  {
+    /* next contiguous run of video data in the input buffer */
+    if (System_Stream_Flag && ld->Rdptr >= ld->Rdmax)
     {
-      do
-      {
-        ld->Bfr |= *ld->Rdptr++ << (24 - Incnt);
-        Incnt += 8;
-      }
-      while (Incnt <= 24);
+      Next_Packet();
+      continue;
     }
-    else
+    while (ld->Rdptr >= ld->Rdend)
     {
-      do
-      {
-        if (ld->Rdptr >= ld->Rdbfr+2048)
-          Fill_Buffer();
-        ld->Bfr |= *ld->Rdptr++ << (24 - Incnt);
-        Incnt += 8;
-      }
-      while (Incnt <= 24);
+      Skip = ld->Rdptr - ld->Rdend;
+      Fill_Buffer();
+      ld->Rdptr += Skip;
     }
-    ld->Incnt = Incnt;
-  }
-
-#ifdef VERIFY 
-  ld->Bitcnt += N;
-#endif /* VERIFY */
-
-}
-
 
-/* return next n bits (right adjusted) */
+    p = ld->Rdptr;
+    Limit = ld->Rdend;
+    if (System_Stream_Flag && ld->Rdmax < Limit)
+      Limit = ld->Rdmax;
 
-unsigned int Get_Bits(N)
-int N;
-{
-  unsigned int Val;
+    while ((q = (unsigned char *)memchr(p,0x01,(size_t)(Limit-p)))!=NULL)
+    {
+      if ((q-p>=2 && q[-1]==0 && q[-2]==0)
+          || (q-p==1 && q[-1]==0 && Zeros>=1)
+          || (q==p && Zeros==2))
+      {
+        /* the zero bytes need not be in this run: restore them as
+           such and load the reservoir from the 0x01 byte on */
+        Skipped += q - ld->Rdptr - 2;
+        ld->Rdptr = q;
+        ld->Bfr = 0;
+        ld->Incnt = 16;
+        Flush_Buffer(0);
+#ifdef VERIFY
+        ld->Bitcnt += 8*Skipped;
+#endif /* VERIFY */
+        return;
+      }
+      Zeros = 0;
+      p = q + 1;
+    }
 
-  Val = Show_Bits(N);
-  Flush_Buffer(N);
+    /* no prefix in this run: remember its trailing zero bytes */
+    for (k=0; k<2 && Limit-k>p && Limit[-1-k]==0; k++)
+      ;
+    if (k==Limit-p)
+      Zeros = (Zeros+k>2) ? 2 : Zeros+k;
+    else
+      Zeros = k;
 
-  return Val;
+    Skipped += Limit - ld->Rdptr;
+    ld->Rdptr = Limit;
+  }
 }
-
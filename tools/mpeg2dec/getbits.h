@@ -0,0 +1,121 @@
+/* getbits.h, inline bit level routines                                     */
+
+/* Copyright (C) 1996, MPEG Software Simulation Group. All Rights Reserved. */
+
+/*
+ * Disclaimer of Warranty
+ *
+ * These software programs are available to the user without any license fee or
+ * royalty on an "as is" basis.  The MPEG Software Simulation Group disclaims
+ * any and all warranties, whether express, implied, or statuary, including any
+ * implied warranties or merchantability or of fitness for a particular
+ * purpose.  In no event shall the copyright-holder be liable for any
+ * incidental, punitive, or consequential damages of any kind whatsoever
+ * arising from the use of these programs.
+ *
+ * This disclaimer of warranty extends to the user of these programs and user's
+ * customers, employees, agents, transferees, successors, and assigns.
+ *
+ * The MPEG Software Simulation Group does not represent or warrant that the
+ * programs furnished hereunder are free of infringement of any third-party
+ * patents.
+ *
+ * Commercial implementations of MPEG-1 and MPEG-2 video, including shareware,
+ * are subject to royalty fees to patent holders.  Many of these patents are
+ * general enough such that they are unavoidable regardless of implementation
+ * design.
+ *
+ */
+
+
+/* The bit reader keeps up to 64 not yet consumed bits of the current
+ * layer in ld->Bfr, MSB aligned; ld->Incnt counts the valid bits.
+ * Every Flush_Buffer() leaves at least 32 valid bits behind, so
+ * Show_Bits(n) and Get_Bits(n) are a shift for any n<=32.
+ *
+ * The reservoir is refilled eight bytes at a time with a single big-endian
+ * load as long as those bytes are known to be contiguous video data:
+ * inside the current buffer (Rdbfr[] or the memory mapped file) and, for
+ * system streams, inside the current packet.
+ * Buffer edges, packet boundaries and end of file are handled by
+ * Refill_Buffer() in getbits.c, which feeds the reservoir byte by byte.
+ */
+
+/* load eight bytes in network (big-endian) order */
+INLINE unsigned long long Load_BE64(p)
+unsigned char *p;
+{
+  return ((unsigned long long)p[0]<<56) | ((unsigned long long)p[1]<<48)
+       | ((unsigned long long)p[2]<<40) | ((unsigned long long)p[3]<<32)
+       | ((unsigned long long)p[4]<<24) | ((unsigned long long)p[5]<<16)
+       | ((unsigned long long)p[6]<<8)  |  (unsigned long long)p[7];
+}
+
+/* return next n bits (right adjusted) without advancing */
+
+INLINE unsigned int Show_Bits(N)
+int N;
+{
+  return (unsigned int)(ld->Bfr >> (64-N));
+}
+
+
+/* advance by n bits (n<=32) */
+
+INLINE void Flush_Buffer(N)
+int N;
+{
+  int Incnt;
+
+  ld->Bfr <<= N;
+
+  Incnt = ld->Incnt -= N;
+
+  if (Incnt < 32)
+  {
+    if (ld->Rdptr+8 <= ld->Rdend
+        && (!System_Stream_Flag || ld->Rdptr+8 <= ld->Rdmax))
+    {
+      /* fast path: append as many whole bytes as fit, then clear the
+         partial byte that was shifted in behind them */
+      ld->Bfr |= Load_BE64(ld->Rdptr) >> Incnt;
+      ld->Rdptr += (64-Incnt)>>3;
+      Incnt += (64-Incnt) & ~7;
+      ld->Bfr &= ~0ULL << (64-Incnt);
+      ld->Incnt = Incnt;
+    }
+    else
+      Refill_Buffer();
+  }
+
+#ifdef VERIFY 
+  ld->Bitcnt += N;
+#endif /* VERIFY */
+}
+
+
+/* return next n bits (right adjusted) */
+
+INLINE unsigned int Get_Bits(N)
+int N;
+{
+  unsigned int Val;
+
+  Val = Show_Bits(N);
+  Flush_Buffer(N);
+
+  return Val;
+}
+
+
+/* return next bit */
+
+INLINE unsigned int Get_Bits1()
+{
+  unsigned int Val;
+
+  Val = (unsigned int)(ld->Bfr >> 63);
+  Flush_Buffer(1);
+
+  return Val;
+}
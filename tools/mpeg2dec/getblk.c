@@ -28,6 +28,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "config.h"
 #include "global.h"
@@ -42,368 +43,337 @@ extern DCTtab DCTtabfirst[],DCTtabnext[],DCTtab0[],DCTtab1[];
 extern DCTtab DCTtab2[],DCTtab3[],DCTtab4[],DCTtab5[],DCTtab6[];
 extern DCTtab DCTtab0a[],DCTtab1a[];
 
-
-/* decode one intra coded MPEG-1 block */
-
-void Decode_MPEG1_Intra_Block(comp,dc_dct_pred)
-int comp;
-int dc_dct_pred[];
+/* The tables above are indexed through a chain of range checks on the
+ * next 16 bits. For the block loops below they are flattened once, by
+ * Initialize_DCT_Tables(), into direct lookup tables that are indexed by
+ * the next 17 bits of the bitstream, i.e. the longest code and its sign:
+ *
+ *  - codes of up to 10 bits (anything not starting with seven zeros):
+ *    DCTvlc0[] (table B-14) or DCTvlc1[] (table B-15), indexed by the
+ *    first 11 bits; len includes the sign bit, which is decoded as well
+ *  - the first coefficient of a non-intra block: DCTvlc_first[], which is
+ *    DCTvlc0[] with code 1s instead of 11s and end_of_block
+ *  - codes 0000000xxxxxxxxx (11 to 16 bits, the same in all tables):
+ *    DCTvlc_long[], indexed by the last 10 of the 17 bits
+ *
+ * end_of_block, escape and invalid codes have run DCT_EOB, DCT_ESCAPE and
+ * DCT_ERROR and a len without sign bit.
+ */
+typedef struct {
+  char run, level, len, sign;
+} DCTvlc;
+
+#define DCT_EOB    64
+#define DCT_ESCAPE 65
+#define DCT_ERROR  66
+
+static DCTvlc DCTvlc0[2048], DCTvlc1[2048], DCTvlc_first[2048];
+static DCTvlc DCTvlc_long[1024];
+
+/* private prototypes */
+static DCTtab *DCT_Table_Entry _ANSI_ARGS_((unsigned int code, int one));
+static void Set_DCT_Entry _ANSI_ARGS_((DCTvlc *vlc, DCTtab *tab, int sign));
+static void MPEG2_Intra_Zigzag_B14 _ANSI_ARGS_((int comp, int dc_dct_pred[]));
+static void MPEG2_Intra_Zigzag_B15 _ANSI_ARGS_((int comp, int dc_dct_pred[]));
+static void MPEG2_Intra_Alternate_B14 _ANSI_ARGS_((int comp, int dc_dct_pred[]));
+static void MPEG2_Intra_Alternate_B15 _ANSI_ARGS_((int comp, int dc_dct_pred[]));
+static void MPEG2_Non_Intra_Zigzag _ANSI_ARGS_((int comp));
+static void MPEG2_Non_Intra_Alternate _ANSI_ARGS_((int comp));
+
+
+/* entry of table B-14 (one==0) or B-15 (one==1) for the 16 bit code
+   (the search the block loops used to do themselves) */
+static DCTtab *DCT_Table_Entry(code,one)
+unsigned int code;
+int one;
 {
-  int val, i, j, sign;
-  unsigned int code;
-  DCTtab *tab;
-  short *bp;
-
-  bp = ld->block[comp];
-
-  /* ISO/IEC 11172-2 section 2.4.3.7: Block layer. */
-  /* decode DC coefficients */
-  if (comp<4)
-    bp[0] = (dc_dct_pred[0]+=Get_Luma_DC_dct_diff()) << 3;
-  else if (comp==4)
-    bp[0] = (dc_dct_pred[1]+=Get_Chroma_DC_dct_diff()) << 3;
+  if (code>=16384 && !one)
+    return &DCTtabnext[(code>>12)-4];
+  else if (code>=1024)
+    return one ? &DCTtab0a[(code>>8)-4] : &DCTtab0[(code>>8)-4];
+  else if (code>=512)
+    return one ? &DCTtab1a[(code>>6)-8] : &DCTtab1[(code>>6)-8];
+  else if (code>=256)
+    return &DCTtab2[(code>>4)-16];
+  else if (code>=128)
+    return &DCTtab3[(code>>3)-16];
+  else if (code>=64)
+    return &DCTtab4[(code>>2)-16];
+  else if (code>=32)
+    return &DCTtab5[(code>>1)-16];
+  else if (code>=16)
+    return &DCTtab6[code-16];
   else
-    bp[0] = (dc_dct_pred[2]+=Get_Chroma_DC_dct_diff()) << 3;
-
-  if (Fault_Flag) return;
-
-  /* D-pictures do not contain AC coefficients */
-  if(picture_coding_type == D_TYPE)
-    return;
+    return NULL;
+}
 
-  /* decode AC coefficients */
-  for (i=1; ; i++)
+static void Set_DCT_Entry(vlc,tab,sign)
+DCTvlc *vlc;
+DCTtab *tab;
+int sign;
+{
+  if (tab==NULL)
   {
-    code = Show_Bits(16);
-    if (code>=16384)
-      tab = &DCTtabnext[(code>>12)-4];
-    else if (code>=1024)
-      tab = &DCTtab0[(code>>8)-4];
-    else if (code>=512)
-      tab = &DCTtab1[(code>>6)-8];
-    else if (code>=256)
-      tab = &DCTtab2[(code>>4)-16];
-    else if (code>=128)
-      tab = &DCTtab3[(code>>3)-16];
-    else if (code>=64)
-      tab = &DCTtab4[(code>>2)-16];
-    else if (code>=32)
-      tab = &DCTtab5[(code>>1)-16];
-    else if (code>=16)
-      tab = &DCTtab6[code-16];
-    else
-    {
-      if (!Quiet_Flag)
-        printf("invalid Huffman code in Decode_MPEG1_Intra_Block()\n");
-      Fault_Flag = 1;
-      return;
-    }
-
-    Flush_Buffer(tab->len);
-
-    if (tab->run==64) /* end_of_block */
-      return;
-
-    if (tab->run==65) /* escape */
-    {
-#ifdef TRACE_DCT
-  if (Trace_Flag)
-    printf(" escape ");
-#endif /* TRACE_DCT */
-      i+= Get_Bits(6);
-
-      val = Get_Bits(8);
-      if (val==0)
-        val = Get_Bits(8);
-      else if (val==128)
-        val = Get_Bits(8) - 256;
-      else if (val>128)
-        val -= 256;
-
-      if((sign = (val<0)))
-        val = -val;
-    }
-    else
-    {
-      i+= tab->run;
-      val = tab->level;
-      sign = Get_Bits(1);
-    }
-
-    if (i>=64)
-    {
-      if (!Quiet_Flag)
-        fprintf(stderr,"DCT coeff index (i) out of bounds (intra)\n");
-      Fault_Flag = 1;
-      return;
-    }
-
-    j = scan[ZIG_ZAG][i];
-    val = (val*ld->quantizer_scale*ld->intra_quantizer_matrix[j]) >> 3;
-
-    /* mismatch control ('oddification') */
-    if (val!=0) /* should always be true, but it's not guaranteed */
-      val = (val-1) | 1; /* equivalent to: if ((val&1)==0) val = val - 1; */
-
-    /* saturation */
-    if (!sign)
-      bp[j] = (val>2047) ?  2047 :  val; /* positive */
-    else
-      bp[j] = (val>2048) ? -2048 : -val; /* negative */
+    vlc->run = DCT_ERROR;
+    vlc->level = vlc->len = vlc->sign = 0;
+  }
+  else if (tab->run>=64)
+  {
+    vlc->run = tab->run==64 ? DCT_EOB : DCT_ESCAPE;
+    vlc->level = vlc->sign = 0;
+    vlc->len = tab->len;
+  }
+  else
+  {
+    vlc->run = tab->run;
+    vlc->level = tab->level;
+    vlc->len = tab->len + 1;
+    vlc->sign = sign;
   }
 }
 
-
-/* decode one non-intra coded MPEG-1 block */
-
-void Decode_MPEG1_Non_Intra_Block(comp)
-int comp;
+/* build DCTvlc0[], DCTvlc1[], DCTvlc_first[] and DCTvlc_long[], see above */
+void Initialize_DCT_Tables()
 {
-  int val, i, j, sign;
-  unsigned int code;
+  int i, one;
   DCTtab *tab;
-  short *bp;
+  DCTvlc *vlc;
 
-  bp = ld->block[comp];
-
-  /* decode AC coefficients */
-  for (i=0; ; i++)
+  for (one=0; one<2; one++)
   {
-    code = Show_Bits(16);
-    if (code>=16384)
-    {
-      if (i==0)
-        tab = &DCTtabfirst[(code>>12)-4];
-      else
-        tab = &DCTtabnext[(code>>12)-4];
-    }
-    else if (code>=1024)
-      tab = &DCTtab0[(code>>8)-4];
-    else if (code>=512)
-      tab = &DCTtab1[(code>>6)-8];
-    else if (code>=256)
-      tab = &DCTtab2[(code>>4)-16];
-    else if (code>=128)
-      tab = &DCTtab3[(code>>3)-16];
-    else if (code>=64)
-      tab = &DCTtab4[(code>>2)-16];
-    else if (code>=32)
-      tab = &DCTtab5[(code>>1)-16];
-    else if (code>=16)
-      tab = &DCTtab6[code-16];
-    else
-    {
-      if (!Quiet_Flag)
-        printf("invalid Huffman code in Decode_MPEG1_Non_Intra_Block()\n");
-      Fault_Flag = 1;
-      return;
-    }
-
-    Flush_Buffer(tab->len);
-
-    if (tab->run==64) /* end_of_block */
-      return;
-
-    if (tab->run==65) /* escape */
-    {
-#ifdef TRACE_DCT
-  if (Trace_Flag)
-    printf(" escape ");
-#endif /* TRACE_DCT */
-      i+= Get_Bits(6);
-
-      val = Get_Bits(8);
-      if (val==0)
-        val = Get_Bits(8);
-      else if (val==128)
-        val = Get_Bits(8) - 256;
-      else if (val>128)
-        val -= 256;
-
-      if((sign = (val<0)))
-        val = -val;
-    }
-    else
-    {
-      i+= tab->run;
-      val = tab->level;
-      sign = Get_Bits(1);
-    }
+    vlc = one ? DCTvlc1 : DCTvlc0;
 
-    if (i>=64)
+    /* the first 16 entries are those of DCTvlc_long[] */
+    for (i=16; i<2048; i++)
     {
-      if (!Quiet_Flag)
-        fprintf(stderr,"DCT coeff index (i) out of bounds (inter)\n");
-      Fault_Flag = 1;
-      return;
+      tab = DCT_Table_Entry(i<<5,one);
+      Set_DCT_Entry(&vlc[i],tab,(i>>(10-tab->len))&1);
     }
+  }
 
-    j = scan[ZIG_ZAG][i];
-    val = (((val<<1)+1)*ld->quantizer_scale*ld->non_intra_quantizer_matrix[j]) >> 4;
-
-    /* mismatch control ('oddification') */
-    if (val!=0) /* should always be true, but it's not guaranteed */
-      val = (val-1) | 1; /* equivalent to: if ((val&1)==0) val = val - 1; */
+  for (i=0; i<1024; i++)
+  {
+    tab = DCT_Table_Entry(i>>1,0);
+    Set_DCT_Entry(&DCTvlc_long[i],tab,tab ? (i>>(16-tab->len))&1 : 0);
+  }
 
-    /* saturation */
-    if (!sign)
-      bp[j] = (val>2047) ?  2047 :  val; /* positive */
+  /* DCTtabfirst[]: code 1s is run 0, level 1 */
+  for (i=0; i<2048; i++)
+    if (i<1024)
+      DCTvlc_first[i] = DCTvlc0[i];
     else
-      bp[j] = (val>2048) ? -2048 : -val; /* negative */
-  }
+      Set_DCT_Entry(&DCTvlc_first[i],&DCTtabfirst[4],(i>>9)&1);
 }
 
 
-/* decode one intra coded MPEG-2 block */
-
-void Decode_MPEG2_Intra_Block(comp,dc_dct_pred)
+/* Decode_Block() is the block layer of both standards, for intra and
+ * non-intra blocks. The arguments after dc_dct_pred select the variant:
+ *
+ *   mpeg2  MPEG-2 (escape with 12 bit level, ISO/IEC 13818-2 inverse
+ *          quantization) rather than MPEG-1
+ *   intra  intra block: DC coefficient and intra quantization
+ *   vlc    DCTvlc0[] or DCTvlc1[] for the AC coefficients of intra blocks
+ *          (non-intra blocks always use table B-14), NULL: as signalled
+ *          by intra_vlc_format
+ *   scn    scan[ZIG_ZAG] or scan[1], NULL: as signalled by alternate_scan
+ *   scal   data partitioning or SNR scalability may be in use
+ *
+ * It is always inlined, so a call with constant arguments is a block
+ * decoder of its own without any of the tests for the other variants.
+ * The public Decode_MPEG*_Block() functions handle any picture; for
+ * MPEG-2 without data partitioning or SNR scalability,
+ * Select_Block_Decoders() picks one of the specialized decoders further
+ * down once per picture.
+ *
+ * Coefficients are saturated as they are stored (ISO/IEC 13818-2 section
+ * 7.4.3), except for the layers of SNR scalability, which are added up
+ * first (Sum_Block() in getpic.c). What the block holds is noted in
+ * ld1->Coefs[comp] for mismatch control, the IDCT and Clear_Block().
+ */
+ALWAYS_INLINE void Decode_Block(comp,dc_dct_pred,mpeg2,intra,vlc,scn,scal)
 int comp;
 int dc_dct_pred[];
+int mpeg2, intra;
+DCTvlc *vlc;
+unsigned char *scn;
+int scal;
 {
-  int val, i, j, sign, nc, cc, run;
+  int val, i, j, sign, nc, cc, run, sat, last, rows, cols, sum;
   unsigned int code;
-  DCTtab *tab;
+  DCTvlc *tab, *first;
   short *bp;
-  int *qmat;
+  int *quant;
   struct layer_data *ld1;
+  struct block_coefs *coefs;
 
   /* with data partitioning, data always goes to base layer */
-  ld1 = (ld->scalable_mode==SC_DP) ? &base : ld;
+  ld1 = (scal && ld->scalable_mode==SC_DP) ? &base : ld;
   bp = ld1->block[comp];
 
-  if (base.scalable_mode==SC_DP)
+  /* SNR scalability: saturation follows Sum_Block() */
+  sat = !(scal && Two_Streams && enhan.scalable_mode==SC_SNR);
+
+  if (scal && base.scalable_mode==SC_DP)
+  {
     if (base.priority_breakpoint<64)
       ld = &enhan;
     else
       ld = &base;
+  }
 
-  cc = (comp<4) ? 0 : (comp&1)+1;
-
-  qmat = (comp<4 || chroma_format==CHROMA420)
-         ? ld1->intra_quantizer_matrix
-         : ld1->chroma_intra_quantizer_matrix;
+  if (scn==NULL)
+    scn = scan[ld1->alternate_scan];
 
-  /* ISO/IEC 13818-2 section 7.2.1: decode DC coefficients */
-  if (cc==0)
-    val = (dc_dct_pred[0]+= Get_Luma_DC_dct_diff());
-  else if (cc==1)
-    val = (dc_dct_pred[1]+= Get_Chroma_DC_dct_diff());
+  /* the matrix times quantizer_scale, in scan order (Set_Quantizer_Scale);
+     MPEG-1 has a single pair of matrices (and no chroma_format) */
+  if (!mpeg2 || comp<4 || chroma_format==CHROMA420)
+    quant = ld1->Quant[intra ? 0 : 1];
   else
-    val = (dc_dct_pred[2]+= Get_Chroma_DC_dct_diff());
+    quant = ld1->Quant[intra ? 2 : 3];
+
+  if (intra)
+  {
+    if (vlc==NULL)
+      vlc = intra_vlc_format ? DCTvlc1 : DCTvlc0;
+    first = vlc;
+
+    cc = (comp<4) ? 0 : (comp&1)+1;
+
+    /* ISO/IEC 13818-2 section 7.2.1: decode DC coefficients */
+    if (cc==0)
+      val = (dc_dct_pred[0]+= Get_Luma_DC_dct_diff());
+    else if (cc==1)
+      val = (dc_dct_pred[1]+= Get_Chroma_DC_dct_diff());
+    else
+      val = (dc_dct_pred[2]+= Get_Chroma_DC_dct_diff());
 
 #ifdef TRACE_DCT
-  if (Trace_Flag)
-    printf("DCT_DC: %i\n", val);
+    if (Trace_Flag)
+      printf("DCT_DC: %i\n", val);
 #endif /* TRACE_DCT */
 
-  if (Fault_Flag) return;
+    if (Fault_Flag) return;
+
+    val <<= mpeg2 ? 3-intra_dc_precision : 3;
+    if (mpeg2 && sat)
+      val = (val>2047) ? 2047 : (val<-2048) ? -2048 : val;
 
-  bp[0] = val << (3-intra_dc_precision);
+    bp[0] = sum = val;
+    rows = cols = 1;
+    last = 0;
+    nc = 0;
 
-  nc=0;
+    /* D-pictures do not contain AC coefficients */
+    if (!mpeg2 && picture_coding_type==D_TYPE)
+      goto done;
+
+    i = 1;
+  }
+  else
+  {
+    vlc = DCTvlc0;
+    first = DCTvlc_first;
+    rows = cols = sum = last = 0;
+    nc = 0;
+    i = 0;
+  }
 
 #ifdef TRACE_DCT
   if (Trace_Flag)
-    printf("DCT(%d)i:",comp);
+    printf("DCT(%d)%c:",comp,intra ? 'i' : 'n');
 #endif /* TRACE_DCT */
 
   /* decode AC coefficients */
-  for (i=1; ; i++)
+  for (; ; i++)
   {
-    code = Show_Bits(16);
-    if (code>=16384 && !intra_vlc_format)
-      tab = &DCTtabnext[(code>>12)-4];
-    else if (code>=1024)
-    {
-      if (intra_vlc_format)
-        tab = &DCTtab0a[(code>>8)-4];
-      else
-        tab = &DCTtab0[(code>>8)-4];
-    }
-    else if (code>=512)
-    {
-      if (intra_vlc_format)
-        tab = &DCTtab1a[(code>>6)-8];
-      else
-        tab = &DCTtab1[(code>>6)-8];
-    }
-    else if (code>=256)
-      tab = &DCTtab2[(code>>4)-16];
-    else if (code>=128)
-      tab = &DCTtab3[(code>>3)-16];
-    else if (code>=64)
-      tab = &DCTtab4[(code>>2)-16];
-    else if (code>=32)
-      tab = &DCTtab5[(code>>1)-16];
-    else if (code>=16)
-      tab = &DCTtab6[code-16];
+    code = Show_Bits(17);
+    if (code>=1024)
+      tab = &first[code>>6];
     else
+      tab = &DCTvlc_long[code&1023];
+    first = vlc;
+
+    Flush_Buffer(tab->len);
+
+    if (tab->run==DCT_ERROR)
     {
       if (!Quiet_Flag)
-        printf("invalid Huffman code in Decode_MPEG2_Intra_Block()\n");
+        printf("invalid Huffman code in Decode_MPEG%d_%sBlock()\n",
+          mpeg2 ? 2 : 1,intra ? "Intra_" : "Non_Intra_");
       Fault_Flag = 1;
-      return;
+      goto done;
     }
 
-    Flush_Buffer(tab->len);
-
 #ifdef TRACE_DCT
     if (Trace_Flag)
     {
       printf(" (");
-      Print_Bits(code,16,tab->len);
+      Print_Bits(code,17,tab->len);
     }
 #endif /* TRACE_DCT */
 
-    if (tab->run==64) /* end_of_block */
+    if (tab->run==DCT_EOB) /* end_of_block */
     {
 #ifdef TRACE_DCT
       if (Trace_Flag)
         printf("): EOB\n");
 #endif /* TRACE_DCT */
-      return;
+      goto done;
     }
 
-    if (tab->run==65) /* escape */
+    if (tab->run==DCT_ESCAPE) /* escape */
     {
-#ifdef TRACE_DCT
-  if (Trace_Flag)
-    printf(" escape ");
-#endif /* TRACE_DCT */
 #ifdef TRACE_DCT
       if (Trace_Flag)
       {
-        putchar(' ');
+        printf(" escape ");
         Print_Bits(Show_Bits(6),6,6);
       }
 #endif /* TRACE_DCT */
 
       i+= run = Get_Bits(6);
 
-#ifdef TRACE_DCT
-      if (Trace_Flag)
+      if (mpeg2)
       {
-        putchar(' ');
-        Print_Bits(Show_Bits(12),12,12);
-      }
+#ifdef TRACE_DCT
+        if (Trace_Flag)
+        {
+          putchar(' ');
+          Print_Bits(Show_Bits(12),12,12);
+        }
 #endif /* TRACE_DCT */
 
-      val = Get_Bits(12);
-      if ((val&2047)==0)
+        val = Get_Bits(12);
+        if ((val&2047)==0)
+        {
+          if (!Quiet_Flag)
+            printf("invalid escape in Decode_MPEG2_%sBlock()\n",
+              intra ? "Intra_" : "Non_Intra_");
+          Fault_Flag = 1;
+          goto done;
+        }
+        if((sign = (val>=2048)))
+          val = 4096 - val;
+      }
+      else
       {
-        if (!Quiet_Flag)
-          printf("invalid escape in Decode_MPEG2_Intra_Block()\n");
-        Fault_Flag = 1;
-        return;
+        val = Get_Bits(8);
+        if (val==0)
+          val = Get_Bits(8);
+        else if (val==128)
+          val = Get_Bits(8) - 256;
+        else if (val>128)
+          val -= 256;
+
+        if((sign = (val<0)))
+          val = -val;
       }
-      if((sign = (val>=2048)))
-        val = 4096 - val;
     }
     else
     {
       i+= run = tab->run;
       val = tab->level;
-      sign = Get_Bits(1);
+      sign = tab->sign;
 
 #ifdef TRACE_DCT
       if (Trace_Flag)
@@ -414,9 +384,10 @@ int dc_dct_pred[];
     if (i>=64)
     {
       if (!Quiet_Flag)
-        fprintf(stderr,"DCT coeff index (i) out of bounds (intra2)\n");
+        fprintf(stderr,"DCT coeff index (i) out of bounds (%s%s)\n",
+          intra ? "intra" : "inter",mpeg2 ? "2" : "");
       Fault_Flag = 1;
-      return;
+      goto done;
     }
 
 #ifdef TRACE_DCT
@@ -424,187 +395,221 @@ int dc_dct_pred[];
       printf("): %d/%d",run,sign ? -val : val);
 #endif /* TRACE_DCT */
 
-    j = scan[ld1->alternate_scan][i];
-
-#ifdef TRACE_DCT_RLD
+#ifdef TRACE_RLD
     if (Trace_Flag)
       printf("\n value before: %d", val);
-#endif /* TRACE_DCT */
-    val = (val * ld1->quantizer_scale * qmat[j]) >> 4;
-#ifdef TRACE_DCT_RLD
-    if (Trace_Flag)
-      printf(" quantizer_scale: %d quant_mat_indx: %d quant_mat: %d value after: %d\n", ld1->quantizer_scale, j, qmat[j], val);
-#endif /* TRACE_DCT */
-    bp[j] = sign ? -val : val;
+#endif /* TRACE_RLD */
+
+    j = scn[i];
+
+    if (mpeg2)
+    {
+      if (intra)
+        val = (val * quant[i]) >> 4;
+      else
+        val = (((val<<1)+1) * quant[i]) >> 5;
+
+#ifdef TRACE_RLD
+      if (Trace_Flag)
+        printf(" quantizer_scale: %d quant_mat_indx: %d scaled quant_mat: %d value after: %d\n", ld1->quantizer_scale, j, quant[i], val);
+#endif /* TRACE_RLD */
+
+      val = sign ? -val : val;
+      if (sat)
+        val = (val>2047) ? 2047 : (val<-2048) ? -2048 : val;
+
+      bp[j] = val;
+      sum += val;
+    }
+    else
+    {
+      if (intra)
+        val = (val*quant[i]) >> 3;
+      else
+        val = (((val<<1)+1)*quant[i]) >> 4;
+
+      /* mismatch control ('oddification') */
+      if (val!=0) /* should always be true, but it's not guaranteed */
+        val = (val-1) | 1; /* equivalent to: if ((val&1)==0) val = val - 1; */
+
+      /* saturation */
+      if (!sign)
+        bp[j] = (val>2047) ?  2047 :  val; /* positive */
+      else
+        bp[j] = (val>2048) ? -2048 : -val; /* negative */
+    }
+
+    rows |= 1<<(j>>3);
+    cols |= 1<<(j&7);
+    last = i;
     nc++;
 
-    if (base.scalable_mode==SC_DP && nc==base.priority_breakpoint-63)
+    if (scal && base.scalable_mode==SC_DP && nc==base.priority_breakpoint-63)
       ld = &enhan;
   }
+
+done:
+  coefs = &ld1->Coefs[comp];
+  coefs->Count = nc + intra;
+  coefs->Last = last;
+  coefs->Rows = rows;
+  coefs->Cols = cols;
+  coefs->Sum = sum;
 }
 
 
-/* decode one non-intra coded MPEG-2 block */
+/* decode one intra coded MPEG-1 block */
 
-void Decode_MPEG2_Non_Intra_Block(comp)
+void Decode_MPEG1_Intra_Block(comp,dc_dct_pred)
 int comp;
+int dc_dct_pred[];
 {
-  int val, i, j, sign, nc, run;
-  unsigned int code;
-  DCTtab *tab;
-  short *bp;
-  int *qmat;
-  struct layer_data *ld1;
+  Decode_Block(comp,dc_dct_pred,0,1,DCTvlc0,scan[ZIG_ZAG],0);
+}
 
-  /* with data partitioning, data always goes to base layer */
-  ld1 = (ld->scalable_mode==SC_DP) ? &base : ld;
-  bp = ld1->block[comp];
 
-  if (base.scalable_mode==SC_DP)
-    if (base.priority_breakpoint<64)
-      ld = &enhan;
-    else
-      ld = &base;
+/* decode one non-intra coded MPEG-1 block */
 
-  qmat = (comp<4 || chroma_format==CHROMA420)
-         ? ld1->non_intra_quantizer_matrix
-         : ld1->chroma_non_intra_quantizer_matrix;
+void Decode_MPEG1_Non_Intra_Block(comp)
+int comp;
+{
+  Decode_Block(comp,NULL,0,0,DCTvlc0,scan[ZIG_ZAG],0);
+}
 
-  nc = 0;
 
-#ifdef TRACE_DCT
-  if (Trace_Flag)
-    printf("DCT(%d)n:",comp);
-#endif /* TRACE_DCT */
+/* decode one intra coded MPEG-2 block */
 
-  /* decode AC coefficients */
-  for (i=0; ; i++)
-  {
-    code = Show_Bits(16);
-    if (code>=16384)
-    {
-      if (i==0)
-        tab = &DCTtabfirst[(code>>12)-4];
-      else
-        tab = &DCTtabnext[(code>>12)-4];
-    }
-    else if (code>=1024)
-      tab = &DCTtab0[(code>>8)-4];
-    else if (code>=512)
-      tab = &DCTtab1[(code>>6)-8];
-    else if (code>=256)
-      tab = &DCTtab2[(code>>4)-16];
-    else if (code>=128)
-      tab = &DCTtab3[(code>>3)-16];
-    else if (code>=64)
-      tab = &DCTtab4[(code>>2)-16];
-    else if (code>=32)
-      tab = &DCTtab5[(code>>1)-16];
-    else if (code>=16)
-      tab = &DCTtab6[code-16];
-    else
-    {
-      if (!Quiet_Flag)
-        printf("invalid Huffman code in Decode_MPEG2_Non_Intra_Block()\n");
-      Fault_Flag = 1;
-      return;
-    }
+void Decode_MPEG2_Intra_Block(comp,dc_dct_pred)
+int comp;
+int dc_dct_pred[];
+{
+  Decode_Block(comp,dc_dct_pred,1,1,NULL,NULL,1);
+}
 
-    Flush_Buffer(tab->len);
 
-#ifdef TRACE_DCT
-    if (Trace_Flag)
-    {
-      printf(" (");
-      Print_Bits(code,16,tab->len);
-    }
-#endif /* TRACE_DCT */
+/* decode one non-intra coded MPEG-2 block */
 
-    if (tab->run==64) /* end_of_block */
-    {
-#ifdef TRACE_DCT
-      if (Trace_Flag)
-        printf("): EOB\n");
-#endif /* TRACE_DCT */
-      return;
-    }
+void Decode_MPEG2_Non_Intra_Block(comp)
+int comp;
+{
+  Decode_Block(comp,NULL,1,0,NULL,NULL,1);
+}
 
-    if (tab->run==65) /* escape */
-    {
-#ifdef TRACE_DCT
-  if (Trace_Flag)
-    printf(" escape ");
-#endif /* TRACE_DCT */
-#ifdef TRACE_DCT
-      if (Trace_Flag)
-      {
-        putchar(' ');
-        Print_Bits(Show_Bits(6),6,6);
-      }
-#endif /* TRACE_DCT */
 
-      i+= run = Get_Bits(6);
+/* MPEG-2 block decoders for one scan and intra VLC table, without data
+   partitioning or SNR scalability */
 
-#ifdef TRACE_DCT
-      if (Trace_Flag)
-      {
-        putchar(' ');
-        Print_Bits(Show_Bits(12),12,12);
-      }
-#endif /* TRACE_DCT */
+static void MPEG2_Intra_Zigzag_B14(comp,dc_dct_pred)
+int comp;
+int dc_dct_pred[];
+{
+  Decode_Block(comp,dc_dct_pred,1,1,DCTvlc0,scan[ZIG_ZAG],0);
+}
 
-      val = Get_Bits(12);
-      if ((val&2047)==0)
-      {
-        if (!Quiet_Flag)
-          printf("invalid escape in Decode_MPEG2_Intra_Block()\n");
-        Fault_Flag = 1;
-        return;
-      }
-      if((sign = (val>=2048)))
-        val = 4096 - val;
-    }
-    else
-    {
-      i+= run = tab->run;
-      val = tab->level;
-      sign = Get_Bits(1);
+static void MPEG2_Intra_Zigzag_B15(comp,dc_dct_pred)
+int comp;
+int dc_dct_pred[];
+{
+  Decode_Block(comp,dc_dct_pred,1,1,DCTvlc1,scan[ZIG_ZAG],0);
+}
 
-#ifdef TRACE_DCT
-      if (Trace_Flag)
-        printf("%d",sign);
-#endif /* TRACE_DCT */
-    }
+static void MPEG2_Intra_Alternate_B14(comp,dc_dct_pred)
+int comp;
+int dc_dct_pred[];
+{
+  Decode_Block(comp,dc_dct_pred,1,1,DCTvlc0,scan[1],0);
+}
 
-    if (i>=64)
-    {
-      if (!Quiet_Flag)
-        fprintf(stderr,"DCT coeff index (i) out of bounds (inter2)\n");
-      Fault_Flag = 1;
-      return;
-    }
+static void MPEG2_Intra_Alternate_B15(comp,dc_dct_pred)
+int comp;
+int dc_dct_pred[];
+{
+  Decode_Block(comp,dc_dct_pred,1,1,DCTvlc1,scan[1],0);
+}
 
-#ifdef TRACE_DCT
-    if (Trace_Flag)
-      printf("): %d/%d",run,sign?-val:val);
-#endif /* TRACE_DCT */
+static void MPEG2_Non_Intra_Zigzag(comp)
+int comp;
+{
+  Decode_Block(comp,NULL,1,0,DCTvlc0,scan[ZIG_ZAG],0);
+}
 
-#ifdef TRACE_RLD
-    if (Trace_Flag)
-      printf("\n value before: %d", val);
-#endif /* TRACE_RLD */
+static void MPEG2_Non_Intra_Alternate(comp)
+int comp;
+{
+  Decode_Block(comp,NULL,1,0,DCTvlc0,scan[1],0);
+}
 
-    j = scan[ld1->alternate_scan][i];
-    val = (((val<<1)+1) * ld1->quantizer_scale * qmat[j]) >> 5;
-#ifdef TRACE_RLD
-    if (Trace_Flag)
-      printf(" quantizer_scale: %d quant_mat_indx: %d quant_mat: %d value after: %d\n", ld1->quantizer_scale, j, qmat[j], val);
-#endif /* TRACE_RLD */
 
-    bp[j] = sign ? -val : val;
-    nc++;
+/* choose the block decoders of layer l for the current picture, once
+   the headers of all layers have been read */
+void Select_Block_Decoders(l)
+struct layer_data *l;
+{
+  if (!l->MPEG2_Flag)
+  {
+    l->Intra_Block = Decode_MPEG1_Intra_Block;
+    l->Non_Intra_Block = Decode_MPEG1_Non_Intra_Block;
+  }
+  else if (l->scalable_mode==SC_DP || base.scalable_mode==SC_DP
+           || (Two_Streams && enhan.scalable_mode==SC_SNR))
+  {
+    l->Intra_Block = Decode_MPEG2_Intra_Block;
+    l->Non_Intra_Block = Decode_MPEG2_Non_Intra_Block;
+  }
+  else if (l->alternate_scan)
+  {
+    l->Intra_Block = intra_vlc_format ? MPEG2_Intra_Alternate_B15
+                                      : MPEG2_Intra_Alternate_B14;
+    l->Non_Intra_Block = MPEG2_Non_Intra_Alternate;
+  }
+  else
+  {
+    l->Intra_Block = intra_vlc_format ? MPEG2_Intra_Zigzag_B15
+                                      : MPEG2_Intra_Zigzag_B14;
+    l->Non_Intra_Block = MPEG2_Non_Intra_Zigzag;
+  }
+}
 
-    if (base.scalable_mode==SC_DP && nc==base.priority_breakpoint-63)
-      ld = &enhan;
+
+/* ISO/IEC 13818-2 section 7.4.2: set quantizer_scale of layer l, and
+   with it the quantizer matrices times quantizer_scale in the order of
+   the current scan, which Decode_Block() multiplies the levels with.
+   The tables of each quantizer_scale are kept until the matrices
+   (Quant_Gen) or the scan change, so switching between a few values
+   costs nothing. */
+void Set_Quantizer_Scale(l,quantizer_scale)
+struct layer_data *l;
+int quantizer_scale;
+{
+  struct quant_table *qt;
+  unsigned char *scn;
+  int i, j, alt;
+
+  alt = l->MPEG2_Flag ? l->alternate_scan : ZIG_ZAG;
+
+  if (!(qt = l->Quant_Cache[quantizer_scale]))
+  {
+    if (!(qt = (struct quant_table *)malloc(sizeof(struct quant_table))))
+      Error("out of memory\n");
+    qt->Gen = l->Quant_Gen - 1;
+    l->Quant_Cache[quantizer_scale] = qt;
   }
+
+  if (qt->Gen!=l->Quant_Gen || qt->Scan!=alt)
+  {
+    scn = scan[alt];
+    for (i=0; i<64; i++)
+    {
+      j = scn[i];
+      qt->Q[0][i] = quantizer_scale * l->intra_quantizer_matrix[j];
+      qt->Q[1][i] = quantizer_scale * l->non_intra_quantizer_matrix[j];
+      qt->Q[2][i] = quantizer_scale * l->chroma_intra_quantizer_matrix[j];
+      qt->Q[3][i] = quantizer_scale * l->chroma_non_intra_quantizer_matrix[j];
+    }
+    qt->Gen = l->Quant_Gen;
+    qt->Scan = alt;
+  }
+
+  l->quantizer_scale = quantizer_scale;
+  l->Quant = qt->Q;
 }
@@ -50,6 +50,7 @@ static int  extra_bit_information _ANSI_ARGS_((void));
 static void copyright_extension _ANSI_ARGS_((void));
 static void user_data _ANSI_ARGS_((void));
 static void user_data _ANSI_ARGS_((void));
+static void skip_picture _ANSI_ARGS_((void));
 
 
 
@@ -57,9 +58,9 @@ static void user_data _ANSI_ARGS_((void));
 /* introduced in September 1995 to assist spatial scalable decoding */
 static void Update_Temporal_Reference_Tacking_Data _ANSI_ARGS_((void));
 /* private variables */
-static int Temporal_Reference_Base = 0;
-static int True_Framenum_max  = -1;
-static int Temporal_Reference_GOP_Reset = 0;
+static THREAD_LOCAL int Temporal_Reference_Base = 0;
+static THREAD_LOCAL int True_Framenum_max  = -1;
+static THREAD_LOCAL int Temporal_Reference_GOP_Reset = 0;
 
 #define RESERVED    -1 
 static double frame_rate_Table[16] =
@@ -91,6 +92,7 @@ static double frame_rate_Table[16] =
 int Get_Hdr()
 {
   unsigned int code;
+  long long pts, dts;
 
   for (;;)
   {
@@ -105,9 +107,31 @@ int Get_Hdr()
       break;
     case GROUP_START_CODE:
       group_of_pictures_header();
+      /* B pictures of a closed GOP need no earlier reference frame */
+      if (closed_gop && !broken_link)
+        Skip_B_Pictures = 0;
       break;
     case PICTURE_START_CODE:
+      /* both fields of a frame are presented at the first one's time */
+      Picture_Timestamps(&pts,&dts);
+      if (ld==&base && !Second_Field)
+      {
+        Picture_PTS = pts;
+        Picture_DTS = dts;
+      }
       picture_header();
+      if (Skip_B_Pictures)
+      {
+        /* random access into an open GOP: B pictures cannot be
+           decoded until two reference frames have been */
+        if (picture_coding_type==B_TYPE)
+        {
+          skip_picture();
+          break;
+        }
+        if (!Second_Field)
+          Skip_B_Pictures--;
+      }
       return 1;
       break;
     case SEQUENCE_END_CODE:
@@ -122,14 +146,61 @@ int Get_Hdr()
 }
 
 
+/* parse the sequence header (and extensions) at the current position,
+ * for random access (index.c); returns 0 if there is none
+ */
+int Get_Sequence_Header()
+{
+  next_start_code();
+  if (Show_Bits(32)!=SEQUENCE_HEADER_CODE)
+    return 0;
+
+  Flush_Buffer32();
+  sequence_header();
+  return 1;
+}
+
+
+/* live input may start anywhere: skip to the first sequence header and
+ * parse it, then skip B pictures like random access into an open GOP
+ * does; returns 0 if the input ends first
+ */
+int Join_Sequence()
+{
+  while (!Get_Sequence_Header())
+  {
+    if (Bitstream_Padding())
+      return 0;
+    Flush_Buffer(8);
+  }
+
+  Skip_B_Pictures = 2;
+  return 1;
+}
+
+
+/* skip the slices of a picture that is not decoded */
+static void skip_picture()
+{
+  unsigned int code;
+
+  for (;;)
+  {
+    next_start_code();
+    code = Show_Bits(32);
+    if (code<SLICE_START_CODE_MIN || code>SLICE_START_CODE_MAX)
+      return;
+    Flush_Buffer32();
+  }
+}
+
+
 /* align to start of next next_start_code */
 
 void next_start_code()
 {
-  /* byte align */
-  Flush_Buffer(ld->Incnt&7);
-  while (Show_Bits(24)!=0x01L)
-    Flush_Buffer(8);
+  /* byte align and skip to the prefix, see getbits.c */
+  Seek_Start_Code();
   if (Trace_Flag)
     printf("  next_start_code\n");
 }
@@ -147,6 +218,7 @@ static void sequence_header()
   vertical_size               = Get_Bits(12);
   aspect_ratio_information    = Get_Bits(4);
   frame_rate_code             = Get_Bits(4);
+  frame_rate = frame_rate_Table[frame_rate_code]; /* MPEG-2: see sequence_extension() */
   bit_rate_value              = Get_Bits(18);
   marker_bit("sequence_header()");
   vbv_buffer_size             = Get_Bits(10);
@@ -196,6 +268,9 @@ static void sequence_header()
       ld->non_intra_quantizer_matrix[i];
   }
 
+  /* tables of Set_Quantizer_Scale() */
+  ld->Quant_Gen++;
+
 #ifdef VERBOSE
   if (Verbose_Flag > NO_LAYER)
   {
@@ -352,8 +427,8 @@ int slice_header()
     ld->priority_breakpoint = Get_Bits(7);
 
   quantizer_scale_code = Get_Bits(5);
-  ld->quantizer_scale =
-    ld->MPEG2_Flag ? (ld->q_scale_type ? Non_Linear_quantizer_scale[quantizer_scale_code] : quantizer_scale_code<<1) : quantizer_scale_code;
+  Set_Quantizer_Scale(ld,
+    ld->MPEG2_Flag ? (ld->q_scale_type ? Non_Linear_quantizer_scale[quantizer_scale_code] : quantizer_scale_code<<1) : quantizer_scale_code);
 
   /* slice_id introduced in March 1995 as part of the video corridendum
      (after the IS was drafted in November 1994) */
@@ -669,6 +744,9 @@ static void quant_matrix_extension()
       );
   }
 
+  /* tables of Set_Quantizer_Scale() */
+  ld->Quant_Gen++;
+
 #ifdef VERBOSE
   if (Verbose_Flag>NO_LAYER)
   {
@@ -1066,8 +1144,8 @@ static void copyright_extension()
 /* introduced in September 1995 to assist Spatial Scalability */
 static void Update_Temporal_Reference_Tacking_Data()
 {
-  static int temporal_reference_wrap  = 0;
-  static int temporal_reference_old   = 0;
+  static THREAD_LOCAL int temporal_reference_wrap  = 0;
+  static THREAD_LOCAL int temporal_reference_old   = 0;
 
   if (ld == &base)			/* *CH* */
   {
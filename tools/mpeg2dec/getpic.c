@@ -28,6 +28,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "config.h"
 #include "global.h"
@@ -42,11 +43,13 @@ static void macroblock_modes _ANSI_ARGS_((int *pmacroblock_type, int *pstwtype,
   int *pstwclass, int *pmotion_type, int *pmotion_vector_count, int *pmv_format, int *pdmv,
   int *pmvscale, int *pdct_type));
 static void Clear_Block _ANSI_ARGS_((int comp));
+static void Skip_Block _ANSI_ARGS_((int comp));
 static void Sum_Block _ANSI_ARGS_((int comp));
 static void Saturate _ANSI_ARGS_((short *bp));
-static void Add_Block _ANSI_ARGS_((int comp, int bx, int by,
-  int dct_type, int addflag));
+static void Block_Layout _ANSI_ARGS_((void));
 static void Update_Picture_Buffers _ANSI_ARGS_((void));
+static void Extend_Field _ANSI_ARGS_((unsigned char *p, int lx, int w, int h,
+  int ex, int ey));
 static void frame_reorder _ANSI_ARGS_((int bitstream_framenum, 
   int sequence_framenum));
 static void Decode_SNR_Macroblock _ANSI_ARGS_((int *SNRMBA, int *SNRMBAinc, 
@@ -61,6 +64,7 @@ static void skipped_macroblock _ANSI_ARGS_((int dc_dct_pred[3],
   int *stwtype, int *macroblock_type));
 
 static int slice _ANSI_ARGS_((int framenum, int MBAmax));
+static int skipped_run_allowed _ANSI_ARGS_((void));
 
 static int start_of_slice _ANSI_ARGS_ ((int MBAmax, int *MBA,
   int *MBAinc, int dc_dct_pred[3], int PMV[2][2][2]));
@@ -70,6 +74,18 @@ static int decode_macroblock _ANSI_ARGS_((int *macroblock_type,
   int PMV[2][2][2], int dc_dct_pred[3], 
   int motion_vertical_field_select[2][2], int dmvector[2]));
 
+/* where the blocks of a macroblock go, and where their prediction is in
+   mb_pred[] (Block_Layout()) */
+static THREAD_LOCAL int block_offset[2][12]; /* [dct_type][comp] */
+static THREAD_LOCAL int block_stride[2][12];
+static THREAD_LOCAL int line_stride[3];      /* [cc] */
+static THREAD_LOCAL int pred_offset[2][12];
+static THREAD_LOCAL int pred_stride[2][12];
+
+/* the prediction of the components of the current macroblock whose
+   blocks are all coded (motion_compensation()) */
+static THREAD_LOCAL unsigned char mb_pred[3][256] ALIGNED(32);
+
 
 /* decode one frame or field picture */
 void Decode_Picture(bitstream_framenum, sequence_framenum)
@@ -85,6 +101,7 @@ int bitstream_framenum, sequence_framenum;
 
   /* IMPLEMENTATION: update picture buffer pointers */
   Update_Picture_Buffers();
+  Block_Layout();
 
 #ifdef VERIFY 
   Check_Headers(bitstream_framenum, sequence_framenum);
@@ -105,9 +122,23 @@ int bitstream_framenum, sequence_framenum;
     Spatial_Prediction();
   }
 
+  /* block decoders for this picture's scan and VLC tables, and its
+     macroblock_type table */
+  Select_Block_Decoders(&base);
+  Select_Macroblock_Type_Table(&base);
+  if (Two_Streams)
+  {
+    Select_Block_Decoders(&enhan);
+    Select_Macroblock_Type_Table(&enhan);
+  }
+
   /* decode picture data ISO/IEC 13818-2 section 6.2.3.7 */
   picture_data(bitstream_framenum);
 
+  /* the edge around reference pictures, for the predictions from them */
+  if (picture_coding_type!=B_TYPE)
+    Extend_Edges(current_frame,picture_structure);
+
   /* write or display current or previously decoded reference frame */
   /* ISO/IEC 13818-2 section 6.1.1.11: Frame reordering */
   frame_reorder(bitstream_framenum, sequence_framenum);
@@ -153,7 +184,7 @@ int framenum, MBAmax;
   int dmvector[2];
   int stwtype, stwclass;
   int SNRMBA, SNRMBAinc;
-  int ret;
+  int ret, n;
 
   MBA = 0; /* macroblock address */
   MBAinc = 0;
@@ -241,6 +272,25 @@ resync: /* if Fault_Flag: resynchronize to next next_start_code */
       /* ISO/IEC 13818-2 section 7.6.6 */
       skipped_macroblock(dc_dct_pred, PMV, &motion_type, 
         motion_vertical_field_select, &stwtype, &macroblock_type);
+
+      /* predict the whole run of skipped macroblocks in one go */
+      if (skipped_run_allowed())
+      {
+        n = MBAinc - 1;
+        if (n>MBAmax-MBA)
+          n = MBAmax - MBA;
+
+        form_skipped_predictions(MBA, n, macroblock_type, PMV,
+          motion_vertical_field_select);
+
+        MBA+= n;
+        MBAinc-= n;
+
+        if (MBA>=MBAmax)
+          return(-1); /* all macroblocks decoded */
+
+        continue;
+      }
     }
 
     /* SCALABILITY: SNR */
@@ -271,6 +321,32 @@ resync: /* if Fault_Flag: resynchronize to next next_start_code */
 }
 
  
+/* whether slice() may hand runs of skipped macroblocks to
+   form_skipped_predictions(), rather than going through them one by one */
+static int skipped_run_allowed()
+{
+  if (picture_coding_type!=P_TYPE && picture_coding_type!=B_TYPE)
+    return 0;
+
+  /* spatial prediction, SNR enhancement layer data */
+  if (base.pict_scal || (Two_Streams && enhan.scalable_mode==SC_SNR))
+    return 0;
+
+#ifdef TRACE
+  if (Trace_Flag)
+    return 0;
+#endif /* TRACE */
+
+#ifdef DISPLAY
+  /* Display_Second_Field() halfway through the picture */
+  if (Output_Type==T_X11)
+    return 0;
+#endif
+
+  return 1;
+}
+
+
 /* ISO/IEC 13818-2 section 6.3.17.1: Macroblock modes */
 static void macroblock_modes(pmacroblock_type,pstwtype,pstwclass,
   pmotion_type,pmotion_vector_count,pmv_format,pdmv,pmvscale,pdct_type)
@@ -415,130 +491,55 @@ static void macroblock_modes(pmacroblock_type,pstwtype,pstwclass,
 }
 
 
-/* move/add 8x8-Block from block[comp] to backward_reference_frame */
-/* copy reconstructed 8x8 block from block[comp] to current_frame[]
- * ISO/IEC 13818-2 section 7.6.8: Adding prediction and coefficient data
- * This stage also embodies some of the operations implied by:
- *   - ISO/IEC 13818-2 section 7.6.7: Combining predictions
- *   - ISO/IEC 13818-2 section 6.1.3: Macroblock
-*/
-static void Add_Block(comp,bx,by,dct_type,addflag)
-int comp,bx,by,dct_type,addflag;
+/* where motion_compensation() stores the 8x8 blocks of each macroblock
+ * of the current picture: block_offset[dct_type][comp] from the top left
+ * pixel of the macroblock in its component, with lines block_stride[][]
+ * apart. The macroblock rows of component cc are 16 times line_stride[cc]
+ * apart (8 times for 4:2:0 chroma). The same for the prediction of the
+ * macroblock in mb_pred[cc], whose lines are the macroblock's width apart:
+ * pred_offset[][] and pred_stride[][].
+ * ISO/IEC 13818-2 section 6.1.3: Macroblock
+ */
+static void Block_Layout()
 {
-  int cc,i, j, iincr;
-  unsigned char *rfp;
-  short *bp;
+  int dct_type, comp, cc, width, mb_w;
 
-  
-  /* derive color component index */
-  /* equivalent to ISO/IEC 13818-2 Table 7-1 */
-  cc = (comp<4) ? 0 : (comp&1)+1; /* color component index */
-
-  if (cc==0)
+  for (cc=0; cc<3; cc++)
   {
-    /* luminance */
-
-    if (picture_structure==FRAME_PICTURE)
-      if (dct_type)
-      {
-        /* field DCT coding */
-        rfp = current_frame[0]
-              + Coded_Picture_Width*(by+((comp&2)>>1)) + bx + ((comp&1)<<3);
-        iincr = (Coded_Picture_Width<<1) - 8;
-      }
-      else
-      {
-        /* frame DCT coding */
-        rfp = current_frame[0]
-              + Coded_Picture_Width*(by+((comp&2)<<2)) + bx + ((comp&1)<<3);
-        iincr = Coded_Picture_Width - 8;
-      }
-    else
-    {
-      /* field picture */
-      rfp = current_frame[0]
-            + (Coded_Picture_Width<<1)*(by+((comp&2)<<2)) + bx + ((comp&1)<<3);
-      iincr = (Coded_Picture_Width<<1) - 8;
-    }
+    width = (cc==0) ? Coded_Picture_Stride : Chroma_Stride;
+    line_stride[cc] = (picture_structure==FRAME_PICTURE) ? width : width<<1;
   }
-  else
-  {
-    /* chrominance */
 
-    /* scale coordinates */
-    if (chroma_format!=CHROMA444)
-      bx >>= 1;
-    if (chroma_format==CHROMA420)
-      by >>= 1;
-    if (picture_structure==FRAME_PICTURE)
+  for (dct_type=0; dct_type<2; dct_type++)
+    for (comp=0; comp<12; comp++)
     {
-      if (dct_type && (chroma_format!=CHROMA420))
+      /* derive color component index */
+      /* equivalent to ISO/IEC 13818-2 Table 7-1 */
+      cc = (comp<4) ? 0 : (comp&1)+1; /* color component index */
+      width = (cc==0) ? Coded_Picture_Stride : Chroma_Stride;
+      mb_w = (cc==0 || chroma_format==CHROMA444) ? 16 : 8;
+
+      if (picture_structure==FRAME_PICTURE && dct_type
+          && (cc==0 || chroma_format!=CHROMA420))
       {
-        /* field DCT coding */
-        rfp = current_frame[cc]
-              + Chroma_Width*(by+((comp&2)>>1)) + bx + (comp&8);
-        iincr = (Chroma_Width<<1) - 8;
+        /* field DCT coding: lines of the top and bottom field interleave */
+        block_offset[dct_type][comp] = width*((comp&2)>>1);
+        block_stride[dct_type][comp] = width<<1;
+        pred_offset[dct_type][comp] = mb_w*((comp&2)>>1);
+        pred_stride[dct_type][comp] = mb_w<<1;
       }
       else
       {
-        /* frame DCT coding */
-        rfp = current_frame[cc]
-              + Chroma_Width*(by+((comp&2)<<2)) + bx + (comp&8);
-        iincr = Chroma_Width - 8;
-      }
-    }
-    else
-    {
-      /* field picture */
-      rfp = current_frame[cc]
-            + (Chroma_Width<<1)*(by+((comp&2)<<2)) + bx + (comp&8);
-      iincr = (Chroma_Width<<1) - 8;
-    }
-  }
-
-  bp = ld->block[comp];
-
-  if (addflag)
-  {
-    for (i=0; i<8; i++)
-    {
-      for (j=0; j<8; j++)
-      {
-#ifdef TRACE_RECON
-        printPixel(rfp);
-        printf (" + idct (=%3i) -> ", *bp);
-#endif /* TRACE_RECON */
-        *rfp = Clip[*bp++ + *rfp];
-#ifdef TRACE_RECON
-        printPixel(rfp);
-        printf ("\n");
-#endif /* TRACE_RECON */
-        rfp++;
+        /* frame DCT coding, or field picture */
+        block_offset[dct_type][comp] = line_stride[cc]*((comp&2)<<2);
+        block_stride[dct_type][comp] = line_stride[cc];
+        pred_offset[dct_type][comp] = mb_w*((comp&2)<<2);
+        pred_stride[dct_type][comp] = mb_w;
       }
 
-      rfp+= iincr;
+      block_offset[dct_type][comp]+= (cc==0) ? (comp&1)<<3 : comp&8;
+      pred_offset[dct_type][comp]+= (cc==0) ? (comp&1)<<3 : comp&8;
     }
-  }
-  else
-  {
-    for (i=0; i<8; i++)
-    {
-      for (j=0; j<8; j++) 
-        {
-#ifdef TRACE_RECON
-        printf ("idct (=%i) + 128 -> ", *bp);
-#endif /* TRACE_RECON */
-        *rfp = Clip[*bp++ + 128];
-#ifdef TRACE_RECON
-        printPixel(rfp);
-        printf ("\n");
-#endif /* TRACE_RECON */
-        rfp++;
-        }
-
-      rfp+= iincr;
-    }
-  }
 }
 
 
@@ -616,8 +617,8 @@ static void Decode_SNR_Macroblock(SNRMBA, SNRMBAinc, MBA, MBAmax, dct_type)
     if (SNRmacroblock_type & MACROBLOCK_QUANT)
     {
       quantizer_scale_code = Get_Bits(5);
-      ld->quantizer_scale =
-        ld->q_scale_type ? Non_Linear_quantizer_scale[quantizer_scale_code] : quantizer_scale_code<<1;
+      Set_Quantizer_Scale(ld,
+        ld->q_scale_type ? Non_Linear_quantizer_scale[quantizer_scale_code] : quantizer_scale_code<<1);
     }
 
     /* macroblock_pattern */
@@ -639,7 +640,7 @@ static void Decode_SNR_Macroblock(SNRMBA, SNRMBAinc, MBA, MBAmax, dct_type)
       Clear_Block(comp);
 
       if (SNRcoded_block_pattern & (1<<(block_count-1-comp)))
-        Decode_MPEG2_Non_Intra_Block(comp);
+        ld->Non_Intra_Block(comp);
     }
   }
   else /* SNRMBAinc!=1: skipped macroblock */
@@ -658,12 +659,32 @@ static void Clear_Block(comp)
 int comp;
 {
   short *Block_Ptr;
-  int i;
+  struct block_coefs *coefs;
+  int i, rows;
 
   Block_Ptr = ld->block[comp];
+  coefs = &ld->Coefs[comp];
 
-  for (i=0; i<64; i++)
-    *Block_Ptr++ = 0;
+  /* the rest of the block is still zero */
+  for (rows=coefs->Rows; rows; rows>>=1, Block_Ptr+=8)
+    if (rows & 1)
+      for (i=0; i<8; i++)
+        Block_Ptr[i] = 0;
+
+  coefs->Count = coefs->Last = coefs->Rows = coefs->Cols = coefs->Sum = 0;
+}
+
+
+/* IMPLEMENTATION: a block without coefficients (coded_block_pattern),
+   which motion_compensation() leaves out; its data is cleared once the
+   block is coded again, unless SNR scalability adds to it */
+static void Skip_Block(comp)
+int comp;
+{
+  if (Two_Streams && enhan.scalable_mode==SC_SNR)
+    Clear_Block(comp);
+  else
+    ld->Coefs[comp].Count = 0;
 }
 
 
@@ -685,6 +706,7 @@ int comp;
 
 /* limit coefficients to -2048..2047 */
 /* ISO/IEC 13818-2 section 7.4.3 and 7.4.4: Saturation and Mismatch control */
+/* (SNR scalability only, the block decoders saturate everything else) */
 static void Saturate(Block_Ptr)
 short *Block_Ptr;
 {
@@ -713,6 +735,64 @@ short *Block_Ptr;
 }
 
 
+/* repeat the border samples of the picture in frame[] into the edge
+   around it in the picture buffers, field by field, so that predictions
+   reaching outside the picture read the nearest samples of the same
+   field: both fields of a FRAME_PICTURE, or the field frame[] points at
+   (as current_frame[] does) */
+void Extend_Edges(frame,structure)
+unsigned char *frame[];
+int structure;
+{
+  int cc, field, fields, lx, w, h, ex, ey;
+
+  fields = (structure==FRAME_PICTURE) ? 2 : 1;
+
+  for (cc=0; cc<3; cc++)
+  {
+    if (cc==0)
+    {
+      lx = Coded_Picture_Stride;
+      w = Coded_Picture_Width;
+      h = Coded_Picture_Height;
+      ex = ey = EDGE;
+    }
+    else
+    {
+      lx = Chroma_Stride;
+      w = Chroma_Width;
+      h = Chroma_Height;
+      ex = Chroma_Edge_Width;
+      ey = Chroma_Edge_Height;
+    }
+
+    for (field=0; field<fields; field++)
+      Extend_Field(frame[cc]+field*lx,lx<<1,w,h>>1,ex,ey>>1);
+  }
+}
+
+/* the edge of ex samples left and right and ey lines above and below the
+   w by h samples at p, with lines lx apart */
+static void Extend_Field(p,lx,w,h,ex,ey)
+unsigned char *p;
+int lx, w, h, ex, ey;
+{
+  int j;
+  unsigned char *q;
+
+  for (j=0, q=p; j<h; j++, q+=lx)
+  {
+    memset(q-ex,q[0],ex);
+    memset(q+w,q[w-1],ex);
+  }
+
+  for (j=1; j<=ey; j++)
+  {
+    memcpy(p-j*lx-ex,p-ex,w+2*ex);
+    memcpy(p+(h-1+j)*lx-ex,p+(h-1)*lx-ex,w+2*ex);
+  }
+}
+
 /* reuse old picture buffers as soon as they are no longer needed 
    based on life-time axioms of MPEG */
 static void Update_Picture_Buffers()
@@ -775,7 +855,14 @@ static void Update_Picture_Buffers()
        memory address of the current frame saves offsets and conditional 
        branches throughout the remainder of the picture processing loop */
     if (picture_structure==BOTTOM_FIELD)
-      current_frame[cc]+= (cc==0) ? Coded_Picture_Width : Chroma_Width;
+      current_frame[cc]+= (cc==0) ? Coded_Picture_Stride : Chroma_Stride;
+  }
+
+  /* the time stamps follow the reference frames */
+  if (picture_coding_type!=B_TYPE && !Second_Field)
+  {
+    forward_reference_PTS = backward_reference_PTS;
+    backward_reference_PTS = Picture_PTS;
   }
 }
 
@@ -788,7 +875,7 @@ int Framenum;
   if (Second_Field)
     printf("last frame incomplete, not stored\n");
   else
-    Write_Frame(backward_reference_frame,Framenum-1);
+    Write_Frame(backward_reference_frame,Framenum-1,backward_reference_PTS);
 }
 
 
@@ -797,20 +884,21 @@ static void frame_reorder(Bitstream_Framenum, Sequence_Framenum)
 int Bitstream_Framenum, Sequence_Framenum;
 {
   /* tracking variables to insure proper output in spatial scalability */
-  static int Oldref_progressive_frame, Newref_progressive_frame;
+  static THREAD_LOCAL int Oldref_progressive_frame, Newref_progressive_frame;
 
   if (Sequence_Framenum!=0)
   {
     if (picture_structure==FRAME_PICTURE || Second_Field)
     {
       if (picture_coding_type==B_TYPE)
-        Write_Frame(auxframe,Bitstream_Framenum-1);
+        Write_Frame(auxframe,Bitstream_Framenum-1,Picture_PTS);
       else
       {
         Newref_progressive_frame = progressive_frame;
         progressive_frame = Oldref_progressive_frame;
 
-        Write_Frame(forward_reference_frame,Bitstream_Framenum-1);
+        Write_Frame(forward_reference_frame,Bitstream_Framenum-1,
+          forward_reference_PTS);
 
         Oldref_progressive_frame = progressive_frame = Newref_progressive_frame;
       }
@@ -841,31 +929,95 @@ int dmvector[2];
 int stwtype;
 int dct_type;
 {
-  int bx, by;
-  int comp;
+  int bx, by, x, y;
+  int comp, cc, n;
   int j, k;
+  struct block_coefs *coefs;
+  unsigned char *mb[3], *pred[3];
+  int lx[3], buffered[3];
+  short *block[12];
+  int rows[12], cols[12];
+  unsigned char *dst[12], *src[12];
+  int stride[12], src_stride[12];
 
   /* derive current macroblock position within picture */
   /* ISO/IEC 13818-2 section 6.3.1.6 and 6.3.1.7 */
   bx = 16*(MBA%mb_width);
   by = 16*(MBA/mb_width);
 
+  /* top left pixel of the macroblock in each component */
+  x = bx;
+  y = by;
+  mb[0] = current_frame[0] + line_stride[0]*y + x;
+  if (chroma_format!=CHROMA444)
+    x >>= 1;
+  if (chroma_format==CHROMA420)
+    y >>= 1;
+  mb[1] = current_frame[1] + line_stride[1]*y + x;
+  mb[2] = current_frame[2] + line_stride[2]*y + x;
+
+  /* SCALABILITY: Data Partitioning */
+  if (base.scalable_mode==SC_DP)
+    ld = &base;
+
   /* motion compensation */
   if (!(macroblock_type & MACROBLOCK_INTRA))
-    form_predictions(bx,by,macroblock_type,motion_type,PMV,
+  {
+    /* the prediction of a component all of whose blocks are coded goes
+       to mb_pred[], from where Add_Macroblock() stores it with the
+       prediction error, each pixel written once; the other components
+       are predicted in place, where their uncoded blocks are done */
+    buffered[0] = buffered[1] = buffered[2] = 1;
+    if (!(Two_Streams && enhan.scalable_mode==SC_SNR))
+      for (comp=0; comp<block_count; comp++)
+        if (ld->Coefs[comp].Count==0)
+          buffered[(comp<4) ? 0 : (comp&1)+1] = 0;
+
+    for (cc=0; cc<3; cc++)
+      if (buffered[cc])
+      {
+        pred[cc] = mb_pred[cc];
+        lx[cc] = (cc==0 || chroma_format==CHROMA444) ? 16 : 8;
+      }
+      else
+      {
+        pred[cc] = mb[cc];
+        lx[cc] = line_stride[cc];
+      }
+
+    /* SCALABILITY: Spatial */
+    /* the spatial prediction in current_frame[] (Spatial_Prediction()),
+       which form_predictions() weights with the temporal one */
+    if (stwtype!=0)
+      for (comp=0; comp<block_count; comp++)
+      {
+        cc = (comp<4) ? 0 : (comp&1)+1; /* color component index */
+        if (buffered[cc])
+          for (j=0; j<8; j++)
+            memcpy(mb_pred[cc] + pred_offset[0][comp] + pred_stride[0][comp]*j,
+                   mb[cc] + block_offset[0][comp] + block_stride[0][comp]*j,8);
+      }
+
+    form_predictions(pred,lx,bx,by,macroblock_type,motion_type,PMV,
       motion_vertical_field_select,dmvector,stwtype);
+  }
 #ifdef TRACE
   else if (Trace_Flag)
     printf ("MC_NONE intra\n");
 #endif
-  
-  /* SCALABILITY: Data Partitioning */
-  if (base.scalable_mode==SC_DP)
-    ld = &base;
 
-  /* copy or add block data into picture */
+  /* collect the coded blocks */
+  n = 0;
   for (comp=0; comp<block_count; comp++)
   {
+    coefs = &ld->Coefs[comp];
+
+    /* uncoded blocks add nothing to the prediction: all their
+       coefficients are zero but for mismatch control's F[7][7], which is
+       too small to change the IDCT output */
+    if (coefs->Count==0 && !(Two_Streams && enhan.scalable_mode==SC_SNR))
+      continue;
+
     /* SCALABILITY: SNR */
     /* ISO/IEC 13818-2 section 7.8.3.4: Addition of coefficients from 
        the two a layers */
@@ -887,8 +1039,17 @@ int dct_type;
     }
 #endif /* TRACE */
     /* ISO/IEC 13818-2 section 7.4.3 and 7.4.4: Saturation and Mismatch control */
-    if ((Two_Streams && enhan.scalable_mode==SC_SNR) || ld->MPEG2_Flag)
+    if (Two_Streams && enhan.scalable_mode==SC_SNR)
+    {
       Saturate(ld->block[comp]);
+      coefs->Rows = coefs->Cols = 0xff;
+    }
+    else if (ld->MPEG2_Flag && (coefs->Sum&1)==0)
+    {
+      /* the block decoders have saturated the coefficients already;
+         Sparse_IDCT() finds F[7][7] without it in Rows and Cols */
+      ld->block[comp][63]^= 1;
+    }
 
 #ifdef TRACE_IDCT
     if (Trace_Flag)
@@ -902,33 +1063,67 @@ int dct_type;
       }
     }
 #endif /* TRACE */
-    /* ISO/IEC 13818-2 section Annex A: inverse DCT */
-    if (Reference_IDCT_Flag)
+    cc = (comp<4) ? 0 : (comp&1)+1; /* color component index */
+    block[n] = ld->block[comp];
+    rows[n] = coefs->Rows;
+    cols[n] = coefs->Cols;
+    dst[n] = mb[cc] + block_offset[dct_type][comp];
+    stride[n] = block_stride[dct_type][comp];
+    if (!(macroblock_type & MACROBLOCK_INTRA) && buffered[cc])
+    {
+      src[n] = mb_pred[cc] + pred_offset[dct_type][comp];
+      src_stride[n] = pred_stride[dct_type][comp];
+    }
+    else
+    {
+      src[n] = dst[n];
+      src_stride[n] = stride[n];
+    }
+    n++;
+
+    /* the IDCT fills the block, for Clear_Block() */
+    coefs->Rows = coefs->Cols = 0xff;
+  }
+
+  /* ISO/IEC 13818-2 section Annex A: inverse DCT */
+  if (Reference_IDCT_Flag)
+    for (k=0; k<n; k++)
 #if HAVE_MMX
-      Reference_IDCT(ld->block[comp],(macroblock_type & MACROBLOCK_INTRA));
+      Reference_IDCT(block[k],(macroblock_type & MACROBLOCK_INTRA));
 #else
-      Reference_IDCT(ld->block[comp]);
+      Reference_IDCT(block[k]);
 #endif
-    else
-      Fast_IDCT(ld->block[comp]);
-    
+  else
+    Sparse_IDCT_Macroblock(block,rows,cols,n);
+
 #ifdef TRACE_IDCT
-    if (Trace_Flag)
+  if (Trace_Flag)
+    for (comp=0; comp<n; comp++)
     {
       printf("after idct:\n");
       for (j=0; j<8; j++) 
       {
 	for (k=0; k<8; k++)
-          printf(" %6d ", (ld->block[comp])[j * 8 + k]);
+          printf(" %6d ", block[comp][j * 8 + k]);
       printf ("\n");
       }
     }
 #endif /* TRACE */
 
-    /* ISO/IEC 13818-2 section 7.6.8: Adding prediction and coefficient data */
-    Add_Block(comp,bx,by,dct_type,(macroblock_type & MACROBLOCK_INTRA)==0);
-  }
+  /* ISO/IEC 13818-2 section 7.6.8: Adding prediction and coefficient data */
+  Add_Macroblock(block,(macroblock_type & MACROBLOCK_INTRA) ? NULL : src,
+    src_stride,dst,stride,n);
 
+#ifdef TRACE_RECON
+  for (comp=0; comp<n; comp++)
+    for (j=0; j<8; j++)
+      for (k=0; k<8; k++)
+      {
+        printf ("idct (=%3i) -> ", block[comp][j*8+k]);
+        printPixel(dst[comp] + stride[comp]*j + k);
+        printf ("\n");
+      }
+#endif /* TRACE_RECON */
 }
 
 
@@ -950,7 +1145,7 @@ int *macroblock_type;
     ld = &base;
 
   for (comp=0; comp<block_count; comp++)
-    Clear_Block(comp);
+    Skip_Block(comp);
 
   /* reset intra_dc predictors */
   /* ISO/IEC 13818-2 section 7.2.1: DC coefficients in intra blocks */
@@ -1142,16 +1337,16 @@ int dmvector[2];
 
     /* ISO/IEC 13818-2 section 7.4.2.2: Quantizer scale factor */
     if (ld->MPEG2_Flag)
-      ld->quantizer_scale =
-      ld->q_scale_type ? Non_Linear_quantizer_scale[quantizer_scale_code] 
-       : (quantizer_scale_code << 1);
+      Set_Quantizer_Scale(ld,
+        ld->q_scale_type ? Non_Linear_quantizer_scale[quantizer_scale_code] 
+         : (quantizer_scale_code << 1));
     else
-      ld->quantizer_scale = quantizer_scale_code;
+      Set_Quantizer_Scale(ld,quantizer_scale_code);
 
     /* SCALABILITY: Data Partitioning */
     if (base.scalable_mode==SC_DP)
       /* make sure base.quantizer_scale is valid */
-      base.quantizer_scale = ld->quantizer_scale;
+      Set_Quantizer_Scale(&base,ld->quantizer_scale);
   }
 
   /* motion vectors */
@@ -1243,35 +1438,26 @@ int dmvector[2];
     if (base.scalable_mode==SC_DP)
     ld = &base;
 
-    Clear_Block(comp);
-
     if (coded_block_pattern & (1<<(block_count-1-comp)))
     {
+      Clear_Block(comp);
+
       if (*macroblock_type & MACROBLOCK_INTRA)
-      {
-        if (ld->MPEG2_Flag)
-          Decode_MPEG2_Intra_Block(comp,dc_dct_pred);
-        else
-          Decode_MPEG1_Intra_Block(comp,dc_dct_pred);
-      }
+        ld->Intra_Block(comp,dc_dct_pred);
       else
-      {
-        if (ld->MPEG2_Flag)
-          Decode_MPEG2_Non_Intra_Block(comp);
-        else
-          Decode_MPEG1_Non_Intra_Block(comp);
-      }
+        ld->Non_Intra_Block(comp);
 
       if (Fault_Flag) return(0);  /* trigger: go to next slice */
     }
-#ifdef TRACE
-  else 
+    else
     {
+      Skip_Block(comp);
+#ifdef TRACE
       if (Trace_Flag) {
         printf("non-coded block\n");
       }
-    }
 #endif
+    }
   }
 
   if(picture_coding_type==D_TYPE)
@@ -33,80 +33,64 @@
 #include "global.h"
 #include "getvlc.h"
 
-/* private prototypes */
-/* generic picture macroblock type processing functions */
-static int Get_I_macroblock_type _ANSI_ARGS_((void));
-static int Get_P_macroblock_type _ANSI_ARGS_((void));
-static int Get_B_macroblock_type _ANSI_ARGS_((void));
-static int Get_D_macroblock_type _ANSI_ARGS_((void));
-
-/* spatial picture macroblock type processing functions */
-static int Get_I_Spatial_macroblock_type _ANSI_ARGS_((void));
-static int Get_P_Spatial_macroblock_type _ANSI_ARGS_((void));
-static int Get_B_Spatial_macroblock_type _ANSI_ARGS_((void));
-static int Get_SNR_macroblock_type _ANSI_ARGS_((void));
-
-int Get_macroblock_type()
-{
-  int macroblock_type = 0;
-
-  if (ld->scalable_mode==SC_SNR)
-    macroblock_type = Get_SNR_macroblock_type();
-  else
-  {
-    switch (picture_coding_type)
-    {
-    case I_TYPE:
-      macroblock_type = ld->pict_scal ? Get_I_Spatial_macroblock_type() : Get_I_macroblock_type();
-      break;
-    case P_TYPE:
-      macroblock_type = ld->pict_scal ? Get_P_Spatial_macroblock_type() : Get_P_macroblock_type();
-      break;
-    case B_TYPE:
-      macroblock_type = ld->pict_scal ? Get_B_Spatial_macroblock_type() : Get_B_macroblock_type();
-      break;
-    case D_TYPE:
-      macroblock_type = Get_D_macroblock_type();
-      break;
-    default:
-      printf("Get_macroblock_type(): unrecognized picture coding type\n");
-      break;
-    }
-  }
-
-  return macroblock_type;
-}
-
-static int Get_I_macroblock_type()
-{
-#ifdef TRACE
-  if (Trace_Flag)
-    printf("macroblock_type(I) ");
-#endif /* TRACE */
-
-  if (Get_Bits1())
-  {
-#ifdef TRACE
-    if (Trace_Flag)
-      printf("(1): Intra (1)\n");
-#endif /* TRACE */
-    return 1;
-  }
+/* The tables in getvlc.h are indexed through a chain of range checks on
+ * the next bits. For the macroblock layer they are flattened once, by
+ * Initialize_VLC_Tables(), into direct lookup tables indexed by as many
+ * bits as the longest code has, so that every syntax element is a single
+ * Show_Bits(), lookup and Flush_Buffer():
+ *
+ *  - MBAvlc[]: macroblock_address_increment, 11 bits; macroblock_escape
+ *    and macroblock_stuffing have val MBA_ESCAPE and MBA_STUFFING
+ *  - MBtype_Tables[]: macroblock_type, one table per picture type (and
+ *    for spatial and SNR scalability), selected once per picture by
+ *    Select_Macroblock_Type_Table()
+ *  - CBPvlc[]: coded_block_pattern_420, 9 bits
+ *  - MVvlc[]: motion_code, 11 bits; len and val include the sign bit
+ *
+ * Invalid codes have len 0.
+ */
 
-  if (!Get_Bits1())
-  {
-    if (!Quiet_Flag)
-      printf("Invalid macroblock_type code\n");
-    Fault_Flag = 1;
-  }
+#define MBA_ESCAPE   64
+#define MBA_STUFFING 65
+
+static VLCtab MBAvlc[2048];
+static VLCtab CBPvlc[512];
+static VLCtab MVvlc[2048];
+
+static VLCtab MBtypeI[4], MBtypeP[64], MBtypeB[64], MBtypeD[2];
+static VLCtab MBtypeSpI[16], MBtypeSpP[128], MBtypeSpB[512];
+static VLCtab MBtypeSNR[8], MBtypeNone[2];
+
+/* indexed by layer_data MB_Type_Table */
+#define MB_TYPE_I     0
+#define MB_TYPE_P     1
+#define MB_TYPE_B     2
+#define MB_TYPE_D     3
+#define MB_TYPE_SP_I  4
+#define MB_TYPE_SP_P  5
+#define MB_TYPE_SP_B  6
+#define MB_TYPE_SNR   7
+#define MB_TYPE_NONE  8
+
+static struct {
+  VLCtab *tab;
+  int bits;
+  char *name;
+} MBtype_Tables[] = {
+  {MBtypeI,   2, "I"},      {MBtypeP,   6, "P"},      {MBtypeB,   6, "B"},
+  {MBtypeD,   1, "D"},      {MBtypeSpI, 4, "I,spat"}, {MBtypeSpP, 7, "P,spat"},
+  {MBtypeSpB, 9, "B,spat"}, {MBtypeSNR, 3, "SNR"},    {MBtypeNone, 1, "?"}
+};
 
-#ifdef TRACE
-  if (Trace_Flag)
-    printf("(01): Intra, Quant (17)\n");
-#endif /* TRACE */
+static VLCtab MBtype_Intra = {MACROBLOCK_INTRA,1};
+static VLCtab MBtype_Intra_Quant = {MACROBLOCK_QUANT|MACROBLOCK_INTRA,2};
+static VLCtab MBA_One = {1,1};
 
-  return 17;
-}
+/* private prototypes */
+static VLCtab *Macroblock_Type_Entry _ANSI_ARGS_((int table, int code));
+static VLCtab *Motion_Code_Entry _ANSI_ARGS_((int code));
+static VLCtab *CBP_Entry _ANSI_ARGS_((int code));
+static VLCtab *MBA_Entry _ANSI_ARGS_((int code));
 
 static char *MBdescr[]={
   "",                  "Intra",        "No MC, Coded",         "",
@@ -119,207 +103,163 @@ static char *MBdescr[]={
   "",                  "",             "Interp, Coded, Quant", ""
 };
 
-static int Get_P_macroblock_type()
+/* macroblock_type code of MBtype_Tables[table] in the next bits of the
+   table, NULL if invalid (Tables B-2 to B-8) */
+static VLCtab *Macroblock_Type_Entry(table,code)
+int table, code;
 {
-  int code;
-
-#ifdef TRACE
-  if (Trace_Flag)
-    printf("macroblock_type(P) (");
-#endif /* TRACE */
-
-  if ((code = Show_Bits(6))>=8)
-  {
-    code >>= 3;
-    Flush_Buffer(PMBtab0[code].len);
-#ifdef TRACE
-    if (Trace_Flag)
-    {
-      Print_Bits(code,3,PMBtab0[code].len);
-      printf("): %s (%d)\n",MBdescr[(int)PMBtab0[code].val],PMBtab0[code].val);
-    }
-#endif /* TRACE */
-    return PMBtab0[code].val;
-  }
-
-  if (code==0)
-  {
-    if (!Quiet_Flag)
-      printf("Invalid macroblock_type code\n");
-    Fault_Flag = 1;
-    return 0;
-  }
-
-  Flush_Buffer(PMBtab1[code].len);
-
-#ifdef TRACE
-  if (Trace_Flag)
-  {
-    Print_Bits(code,6,PMBtab1[code].len);
-    printf("): %s (%d)\n",MBdescr[(int)PMBtab1[code].val],PMBtab1[code].val);
-  }
-#endif /* TRACE */
-
-  return PMBtab1[code].val;
+  switch (table)
+  {
+  case MB_TYPE_I:
+    return (code>=2) ? &MBtype_Intra : (code==1) ? &MBtype_Intra_Quant : NULL;
+  case MB_TYPE_P:
+    return (code>=8) ? &PMBtab0[code>>3] : code ? &PMBtab1[code] : NULL;
+  case MB_TYPE_B:
+    return (code>=8) ? &BMBtab0[code>>2] : code ? &BMBtab1[code] : NULL;
+  case MB_TYPE_D:
+    return code ? &MBtype_Intra : NULL;
+  case MB_TYPE_SP_I:
+    return code ? &spIMBtab[code] : NULL;
+  case MB_TYPE_SP_P:
+    return (code>=16) ? &spPMBtab0[code>>3] : (code>=2) ? &spPMBtab1[code] : NULL;
+  case MB_TYPE_SP_B:
+    if (code>=64)
+      return &spBMBtab0[(code>>5)-2];
+    if (code>=16)
+      return &spBMBtab1[(code>>2)-4];
+    return (code>=8) ? &spBMBtab2[code-8] : NULL;
+  case MB_TYPE_SNR:
+    return code ? &SNRMBtab[code] : NULL;
+  }
+
+  return NULL;
 }
 
-static int Get_B_macroblock_type()
+/* Table B-10, motion_code following its leading 0 bit (9 bits), NULL if
+   invalid; len does not count the leading 0 and the sign */
+static VLCtab *Motion_Code_Entry(code)
+int code;
 {
-  int code;
-
-#ifdef TRACE
-  if (Trace_Flag)
-    printf("macroblock_type(B) (");
-#endif /* TRACE */
-
-  if ((code = Show_Bits(6))>=8)
-  {
-    code >>= 2;
-    Flush_Buffer(BMBtab0[code].len);
-
-#ifdef TRACE
-    if (Trace_Flag)
-    {
-      Print_Bits(code,4,BMBtab0[code].len);
-      printf("): %s (%d)\n",MBdescr[(int)BMBtab0[code].val],BMBtab0[code].val);
-    }
-#endif /* TRACE */
-
-    return BMBtab0[code].val;
-  }
-
-  if (code==0)
-  {
-    if (!Quiet_Flag)
-      printf("Invalid macroblock_type code\n");
-    Fault_Flag = 1;
-    return 0;
-  }
-
-  Flush_Buffer(BMBtab1[code].len);
-
-#ifdef TRACE
-  if (Trace_Flag)
-  {
-    Print_Bits(code,6,BMBtab1[code].len);
-    printf("): %s (%d)\n",MBdescr[(int)BMBtab1[code].val],BMBtab1[code].val);
-  }
-#endif /* TRACE */
-
-  return BMBtab1[code].val;
+  if (code>=64)
+    return &MVtab0[code>>6];
+  if (code>=24)
+    return &MVtab1[code>>3];
+  return (code>=12) ? &MVtab2[code-12] : NULL;
 }
 
-static int Get_D_macroblock_type()
+/* Table B-9, coded_block_pattern_420 (9 bits), NULL if invalid */
+static VLCtab *CBP_Entry(code)
+int code;
 {
-  if (!Get_Bits1())
-  {
-    if (!Quiet_Flag)
-      printf("Invalid macroblock_type code\n");
-    Fault_Flag=1;
-  }
-
-  return 1;
+  if (code>=128)
+    return &CBPtab0[code>>4];
+  if (code>=8)
+    return &CBPtab1[code>>1];
+  return code ? &CBPtab2[code] : NULL;
 }
 
-/* macroblock_type for pictures with spatial scalability */
-static int Get_I_Spatial_macroblock_type()
+/* Table B-1, macroblock_address_increment other than escape and stuffing
+   (11 bits), NULL if invalid */
+static VLCtab *MBA_Entry(code)
+int code;
 {
-  int code;
-
-#ifdef TRACE
-  if (Trace_Flag)
-    printf("macroblock_type(I,spat) (");
-#endif /* TRACE */
-
-  code = Show_Bits(4);
-
-  if (code==0)
-  {
-    if (!Quiet_Flag)
-      printf("Invalid macroblock_type code\n");
-    Fault_Flag = 1;
-    return 0;
-  }
-
-#ifdef TRACE
-  if (Trace_Flag)
-  {
-    Print_Bits(code,4,spIMBtab[code].len);
-    printf("): %02x\n",spIMBtab[code].val);
-  }
-#endif /* TRACE */
-
-  Flush_Buffer(spIMBtab[code].len);
-  return spIMBtab[code].val;
+  if (code>=1024)
+    return &MBA_One;
+  if (code>=128)
+    return &MBAtab1[code>>6];
+  return (code>=24) ? &MBAtab2[code-24] : NULL;
 }
 
-static int Get_P_Spatial_macroblock_type()
+/* build the lookup tables of the macroblock layer, see above */
+void Initialize_VLC_Tables()
 {
-  int code;
-
-#ifdef TRACE
-  if (Trace_Flag)
-    printf("macroblock_type(P,spat) (");
-#endif /* TRACE */
-
-  code = Show_Bits(7);
+  int i, t, sign;
+  VLCtab *p;
 
-  if (code<2)
+  for (i=0; i<2048; i++)
   {
-    if (!Quiet_Flag)
-      printf("Invalid macroblock_type code\n");
-    Fault_Flag = 1;
-    return 0;
+    if (i==8)
+    {
+      MBAvlc[i].val = MBA_ESCAPE;
+      MBAvlc[i].len = 11;
+    }
+    else if (i==15)
+    {
+      MBAvlc[i].val = MBA_STUFFING;
+      MBAvlc[i].len = 11;
+    }
+    else if ((p = MBA_Entry(i)))
+      MBAvlc[i] = *p;
   }
 
-  if (code>=16)
-  {
-    code >>= 3;
-    Flush_Buffer(spPMBtab0[code].len);
+  for (i=0; i<512; i++)
+    if ((p = CBP_Entry(i)))
+      CBPvlc[i] = *p;
 
-#ifdef TRACE
-    if (Trace_Flag)
+  /* 1: motion_code 0, else 0, the code proper and the sign */
+  for (i=0; i<2048; i++)
+  {
+    if (i>=1024)
     {
-      Print_Bits(code,4,spPMBtab0[code].len);
-      printf("): %02x\n",spPMBtab0[code].val);
+      MVvlc[i].val = 0;
+      MVvlc[i].len = 1;
+    }
+    else if ((p = Motion_Code_Entry(i>>1)))
+    {
+      MVvlc[i].len = p->len + 2;
+      sign = (i>>(11-MVvlc[i].len)) & 1;
+      MVvlc[i].val = sign ? -p->val : p->val;
     }
-#endif /* TRACE */
-
-    return spPMBtab0[code].val;
   }
 
-  Flush_Buffer(spPMBtab1[code].len);
+  for (t=MB_TYPE_I; t<MB_TYPE_NONE; t++)
+    for (i=0; i<(1<<MBtype_Tables[t].bits); i++)
+      if ((p = Macroblock_Type_Entry(t,i)))
+        MBtype_Tables[t].tab[i] = *p;
+}
 
-#ifdef TRACE
-  if (Trace_Flag)
-  {
-    Print_Bits(code,7,spPMBtab1[code].len);
-    printf("): %02x\n",spPMBtab1[code].val);
+/* choose the macroblock_type table of layer l for the current picture */
+void Select_Macroblock_Type_Table(l)
+struct layer_data *l;
+{
+  if (l->scalable_mode==SC_SNR)
+    l->MB_Type_Table = MB_TYPE_SNR;
+  else switch (picture_coding_type)
+  {
+  case I_TYPE:
+    l->MB_Type_Table = l->pict_scal ? MB_TYPE_SP_I : MB_TYPE_I;
+    break;
+  case P_TYPE:
+    l->MB_Type_Table = l->pict_scal ? MB_TYPE_SP_P : MB_TYPE_P;
+    break;
+  case B_TYPE:
+    l->MB_Type_Table = l->pict_scal ? MB_TYPE_SP_B : MB_TYPE_B;
+    break;
+  case D_TYPE:
+    l->MB_Type_Table = MB_TYPE_D;
+    break;
+  default:
+    printf("Get_macroblock_type(): unrecognized picture coding type\n");
+    l->MB_Type_Table = MB_TYPE_NONE;
+    break;
   }
-#endif /* TRACE */
-
-  return spPMBtab1[code].val;
 }
 
-static int Get_B_Spatial_macroblock_type()
+int Get_macroblock_type()
 {
-  int code;
+  int code, bits;
   VLCtab *p;
 
+  bits = MBtype_Tables[ld->MB_Type_Table].bits;
+  code = Show_Bits(bits);
+  p = &MBtype_Tables[ld->MB_Type_Table].tab[code];
+
 #ifdef TRACE
   if (Trace_Flag)
-    printf("macroblock_type(B,spat) (");
+    printf("macroblock_type(%s) (",MBtype_Tables[ld->MB_Type_Table].name);
 #endif /* TRACE */
 
-  code = Show_Bits(9);
-
-  if (code>=64)
-    p = &spBMBtab0[(code>>5)-2];
-  else if (code>=16)
-    p = &spBMBtab1[(code>>2)-4];
-  else if (code>=8)
-    p = &spBMBtab2[code-8];
-  else
+  if (p->len==0)
   {
     if (!Quiet_Flag)
       printf("Invalid macroblock_type code\n");
@@ -332,110 +272,26 @@ static int Get_B_Spatial_macroblock_type()
 #ifdef TRACE
   if (Trace_Flag)
   {
-    Print_Bits(code,9,p->len);
-    printf("): %02x\n",p->val);
+    Print_Bits(code,bits,p->len);
+    if (p->val<32)
+      printf("): %s (%d)\n",MBdescr[(int)p->val],p->val);
+    else
+      printf("): %02x\n",p->val);
   }
 #endif /* TRACE */
 
   return p->val;
 }
 
-static int Get_SNR_macroblock_type()
-{
-  int code;
-
-#ifdef TRACE			/* *CH* */
-  if (Trace_Flag)
-    printf("macroblock_type(SNR) (");
-#endif
-
-  code = Show_Bits(3);
-
-  if (code==0)
-  {
-    if (!Quiet_Flag)
-      printf("Invalid macroblock_type code\n");
-    Fault_Flag = 1;
-    return 0;
-  }
-
-  Flush_Buffer(SNRMBtab[code].len);
-
-#ifdef TRACE			/* *CH* */
-  if (Trace_Flag)
-  {
-    Print_Bits(code,3,SNRMBtab[code].len);
-    printf("): %s (%d)\n",MBdescr[(int)SNRMBtab[code].val],SNRMBtab[code].val);
-  }
-#endif 
-
-
-  return SNRMBtab[code].val;
-}
-
 int Get_motion_code()
 {
   int code;
+  VLCtab *p;
 
-#ifdef TRACE
-  if (Trace_Flag)
-    printf("motion_code (");
-#endif /* TRACE */
-
-  if (Get_Bits1())
-  {
-#ifdef TRACE
-    if (Trace_Flag)
-      printf("1): 0\n");
-#endif /* TRACE */
-    return 0;
-  }
-#ifdef TRACE
-  else
-  {
-    if (Trace_Flag)
-    {
-      printf("0");
-    }
-  }
-#endif /* TRACE */
-
-
-  if ((code = Show_Bits(9))>=64)
-  {
-    code >>= 6;
-    Flush_Buffer(MVtab0[code].len);
-
-#ifdef TRACE
-    if (Trace_Flag)
-    {
-      Print_Bits(code,3,MVtab0[code].len);
-      printf("%d): %d\n",
-        Show_Bits(1),Show_Bits(1)?-MVtab0[code].val:MVtab0[code].val);
-    }
-#endif /* TRACE */
-
-    return Get_Bits1()?-MVtab0[code].val:MVtab0[code].val;
-  }
-
-  if (code>=24)
-  {
-    code >>= 3;
-    Flush_Buffer(MVtab1[code].len);
-
-#ifdef TRACE
-    if (Trace_Flag)
-    {
-      Print_Bits(code,6,MVtab1[code].len);
-      printf("%d): %d\n",
-        Show_Bits(1),Show_Bits(1)?-MVtab1[code].val:MVtab1[code].val);
-    }
-#endif /* TRACE */
-
-    return Get_Bits1()?-MVtab1[code].val:MVtab1[code].val;
-  }
+  code = Show_Bits(11);
+  p = &MVvlc[code];
 
-  if ((code-=12)<0)
+  if (p->len==0)
   {
     if (!Quiet_Flag)
 /* HACK */
@@ -444,18 +300,18 @@ int Get_motion_code()
     return 0;
   }
 
-  Flush_Buffer(MVtab2[code].len);
+  Flush_Buffer(p->len);
 
 #ifdef TRACE
   if (Trace_Flag)
   {
-    Print_Bits(code+12,9,MVtab2[code].len);
-    printf("%d): %d\n",
-      Show_Bits(1),Show_Bits(1)?-MVtab2[code].val:MVtab2[code].val);
+    printf("motion_code (");
+    Print_Bits(code,11,p->len);
+    printf("): %d\n",p->val);
   }
 #endif /* TRACE */
 
-  return Get_Bits1() ? -MVtab2[code].val : MVtab2[code].val;
+  return p->val;
 }
 
 /* get differential motion vector (for dual prime prediction) */
@@ -487,49 +343,12 @@ int Get_dmvector()
 int Get_coded_block_pattern()
 {
   int code;
+  VLCtab *p;
 
-#ifdef TRACE
-  if (Trace_Flag)
-    printf("coded_block_pattern_420 (");
-#endif /* TRACE */
-
-  if ((code = Show_Bits(9))>=128)
-  {
-    code >>= 4;
-    Flush_Buffer(CBPtab0[code].len);
-
-#ifdef TRACE
-    if (Trace_Flag)
-    {
-      Print_Bits(code,5,CBPtab0[code].len);
-      printf("): ");
-      Print_Bits(CBPtab0[code].val,6,6);
-      printf(" (%d)\n",CBPtab0[code].val);
-    }
-#endif /* TRACE */
-
-    return CBPtab0[code].val;
-  }
-
-  if (code>=8)
-  {
-    code >>= 1;
-    Flush_Buffer(CBPtab1[code].len);
-
-#ifdef TRACE
-    if (Trace_Flag)
-    {
-      Print_Bits(code,8,CBPtab1[code].len);
-      printf("): ");
-      Print_Bits(CBPtab1[code].val,6,6);
-      printf(" (%d)\n",CBPtab1[code].val);
-    }
-#endif /* TRACE */
-
-    return CBPtab1[code].val;
-  }
+  code = Show_Bits(9);
+  p = &CBPvlc[code];
 
-  if (code<1)
+  if (p->len==0)
   {
     if (!Quiet_Flag)
       printf("Invalid coded_block_pattern code\n");
@@ -537,24 +356,26 @@ int Get_coded_block_pattern()
     return 0;
   }
 
-  Flush_Buffer(CBPtab2[code].len);
+  Flush_Buffer(p->len);
 
 #ifdef TRACE
   if (Trace_Flag)
   {
-    Print_Bits(code,9,CBPtab2[code].len);
+    printf("coded_block_pattern_420 (");
+    Print_Bits(code,9,p->len);
     printf("): ");
-    Print_Bits(CBPtab2[code].val,6,6);
-    printf(" (%d)\n",CBPtab2[code].val);
+    Print_Bits(p->val,6,6);
+    printf(" (%d)\n",p->val);
   }
 #endif /* TRACE */
 
-  return CBPtab2[code].val;
+  return p->val;
 }
 
 int Get_macroblock_address_increment()
 {
   int code, val;
+  VLCtab *p;
 
 #ifdef TRACE
   if (Trace_Flag)
@@ -563,83 +384,40 @@ int Get_macroblock_address_increment()
 
   val = 0;
 
-  while ((code = Show_Bits(11))<24)
+  /* any number of macroblock_escape and macroblock_stuffing */
+  while ((p = &MBAvlc[code = Show_Bits(11)])->val>=MBA_ESCAPE)
   {
-    if (code!=15) /* if not macroblock_stuffing */
-    {
-      if (code==8) /* if macroblock_escape */
-      {
 #ifdef TRACE
-        if (Trace_Flag)
-          printf("00000001000 ");
+    if (Trace_Flag)
+      printf(p->val==MBA_ESCAPE ? "00000001000 " : "00000001111 ");
 #endif /* TRACE */
 
-        val+= 33;
-      }
-      else
-      {
-        if (!Quiet_Flag)
-          printf("Invalid macroblock_address_increment code\n");
-
-        Fault_Flag = 1;
-        return 1;
-      }
-    }
-    else /* macroblock suffing */
-    {
-#ifdef TRACE
-      if (Trace_Flag)
-        printf("00000001111 ");
-#endif /* TRACE */
-    }
+    if (p->val==MBA_ESCAPE)
+      val+= 33;
 
     Flush_Buffer(11);
   }
 
-  /* macroblock_address_increment == 1 */
-  /* ('1' is in the MSB position of the lookahead) */
-  if (code>=1024)
-  {
-    Flush_Buffer(1);
-#ifdef TRACE
-    if (Trace_Flag)
-      printf("1): %d\n",val+1);
-#endif /* TRACE */
-    return val + 1;
-  }
-
-  /* codes 00010 ... 011xx */
-  if (code>=128)
+  if (p->len==0)
   {
-    /* remove leading zeros */
-    code >>= 6;
-    Flush_Buffer(MBAtab1[code].len);
-
-#ifdef TRACE
-    if (Trace_Flag)
-    {
-      Print_Bits(code,5,MBAtab1[code].len);
-      printf("): %d\n",val+MBAtab1[code].val);
-    }
-#endif /* TRACE */
+    if (!Quiet_Flag)
+      printf("Invalid macroblock_address_increment code\n");
 
-    
-    return val + MBAtab1[code].val;
+    Fault_Flag = 1;
+    return 1;
   }
-  
-  /* codes 00000011000 ... 0000111xxxx */
-  code-= 24; /* remove common base */
-  Flush_Buffer(MBAtab2[code].len);
+
+  Flush_Buffer(p->len);
 
 #ifdef TRACE
   if (Trace_Flag)
   {
-    Print_Bits(code+24,11,MBAtab2[code].len);
-    printf("): %d\n",val+MBAtab2[code].val);
+    Print_Bits(code,11,p->len);
+    printf("): %d\n",val+p->val);
   }
 #endif /* TRACE */
 
-  return val + MBAtab2[code].val;
+  return val + p->val;
 }
 
 /* combined MPEG-1 and MPEG-2 stage. parse VLC and 
@@ -32,31 +32,66 @@
 /* choose between declaration (GLOBAL undefined)
  * and definition (GLOBAL defined)
  * GLOBAL is defined in exactly one file mpeg2dec.c)
+ *
+ * EXTERN variables are decoder state, of which every thread that decodes
+ * a program (multi.c) has its own copy; SHARED ones are the command line
+ * options and constant tables, set up before any such thread starts
  */
 
 #ifndef GLOBAL
-#define EXTERN extern
+#define EXTERN extern THREAD_LOCAL
+#define SHARED extern
 #else
-#define EXTERN
+#define EXTERN THREAD_LOCAL
+#define SHARED
 #endif
 
+/* defined further down */
+struct layer_data;
+
 /* prototypes of global functions */
 /* readpic.c */
 void Substitute_Frame_Buffer _ANSI_ARGS_ ((int bitstream_framenum, 
   int sequence_framenum));
 
 /* Get_Bits.c */
+/* Show_Bits(), Get_Bits(), Get_Bits1() and Flush_Buffer() are in getbits.h */
+int Open_Bitstream _ANSI_ARGS_((char *filename));
+void Close_Bitstream _ANSI_ARGS_((void));
 void Initialize_Buffer _ANSI_ARGS_((void));
+void Reset_Buffer _ANSI_ARGS_((void));
 void Fill_Buffer _ANSI_ARGS_((void));
-unsigned int Show_Bits _ANSI_ARGS_((int n));
-unsigned int Get_Bits1 _ANSI_ARGS_((void));
-void Flush_Buffer _ANSI_ARGS_((int n));
-unsigned int Get_Bits _ANSI_ARGS_((int n));
+void Pad_Buffer _ANSI_ARGS_((int zeros));
+void Refill_Buffer _ANSI_ARGS_((void));
+void Seek_Start_Code _ANSI_ARGS_((void));
+void Seek_Bitstream _ANSI_ARGS_((long offset, int skip));
+long Bitstream_Offset _ANSI_ARGS_((unsigned char *p));
+int Bitstream_Padding _ANSI_ARGS_((void));
 int Get_Byte _ANSI_ARGS_((void));
 int Get_Word _ANSI_ARGS_((void));
 
+/* readahead.c */
+void Start_Readahead _ANSI_ARGS_((int buffers));
+void Stop_Readahead _ANSI_ARGS_((void));
+void Next_Readahead_Buffer _ANSI_ARGS_((void));
+int Peek_Readahead _ANSI_ARGS_((unsigned char *buffer, int size));
+void Transport_Readahead _ANSI_ARGS_((void));
+struct readahead *Open_Ring _ANSI_ARGS_((int buffers));
+void Free_Ring _ANSI_ARGS_((struct readahead *ra));
+unsigned char *Ring_Buffer _ANSI_ARGS_((struct readahead *ra, int *size));
+void Put_Ring_Buffer _ANSI_ARGS_((struct readahead *ra, int length));
+
+/* live.c */
+int Open_Live_Input _ANSI_ARGS_((char *filename));
+
+/* index.c */
+void Write_Index _ANSI_ARGS_((char *filename));
+void Seek_GOP _ANSI_ARGS_((char *filename, int gop));
+
 /* systems.c */
 void Next_Packet _ANSI_ARGS_((void));
+void Print_Demux_Statistics _ANSI_ARGS_((void));
+void Picture_Timestamps _ANSI_ARGS_((long long *pts, long long *dts));
 int Get_Long _ANSI_ARGS_((void));
 void Flush_Buffer32 _ANSI_ARGS_((void));
 unsigned int Get_Bits32 _ANSI_ARGS_((void));
@@ -67,9 +102,15 @@ void Decode_MPEG1_Intra_Block _ANSI_ARGS_((int comp, int dc_dct_pred[]));
 void Decode_MPEG1_Non_Intra_Block _ANSI_ARGS_((int comp));
 void Decode_MPEG2_Intra_Block _ANSI_ARGS_((int comp, int dc_dct_pred[]));
 void Decode_MPEG2_Non_Intra_Block _ANSI_ARGS_((int comp));
+void Initialize_DCT_Tables _ANSI_ARGS_((void));
+void Select_Block_Decoders _ANSI_ARGS_((struct layer_data *l));
+void Set_Quantizer_Scale _ANSI_ARGS_((struct layer_data *l,
+  int quantizer_scale));
 
 /* gethdr.c */
 int Get_Hdr _ANSI_ARGS_((void));
+int Get_Sequence_Header _ANSI_ARGS_((void));
+int Join_Sequence _ANSI_ARGS_((void));
 void next_start_code _ANSI_ARGS_((void));
 int slice_header _ANSI_ARGS_((void));
 void marker_bit _ANSI_ARGS_((char *text));
@@ -78,8 +119,11 @@ void marker_bit _ANSI_ARGS_((char *text));
 void Decode_Picture _ANSI_ARGS_((int bitstream_framenum, 
   int sequence_framenum));
 void Output_Last_Frame_of_Sequence _ANSI_ARGS_((int framenum));
+void Extend_Edges _ANSI_ARGS_((unsigned char *frame[], int structure));
 
 /* getvlc.c */
+void Initialize_VLC_Tables _ANSI_ARGS_((void));
+void Select_Macroblock_Type_Table _ANSI_ARGS_((struct layer_data *l));
 int Get_macroblock_type _ANSI_ARGS_((void));
 int Get_motion_code _ANSI_ARGS_((void));
 int Get_dmvector _ANSI_ARGS_((void));
@@ -90,6 +134,11 @@ int Get_Chroma_DC_dct_diff _ANSI_ARGS_((void));
 
 /* idct.c */
 void Fast_IDCT _ANSI_ARGS_((short *block));
+void Sparse_IDCT _ANSI_ARGS_((short *block, int rows, int cols));
+void Sparse_IDCT_Macroblock _ANSI_ARGS_((short *block[], int rows[],
+  int cols[], int n));
+void Add_Macroblock _ANSI_ARGS_((short *block[], unsigned char *pred[],
+  int pred_stride[], unsigned char *dst[], int stride[], int n));
 void Initialize_Fast_IDCT _ANSI_ARGS_((void));
 
 /* Reference_IDCT.c */
@@ -112,17 +161,29 @@ void Dual_Prime_Arithmetic _ANSI_ARGS_((int DMV[][2], int *dmvector, int mvx, in
 void Error _ANSI_ARGS_((char *text));
 void Warning _ANSI_ARGS_((char *text));
 void Print_Bits _ANSI_ARGS_((int code, int bits, int len));
+void Initialize_Decoder _ANSI_ARGS_((void));
+int Decode_Bitstream _ANSI_ARGS_((void));
+
+/* multi.c */
+int Decode_Programs _ANSI_ARGS_((void));
+void End_Program _ANSI_ARGS_((void));
 
 /* recon.c */
-void form_predictions _ANSI_ARGS_((int bx, int by, int macroblock_type, 
-  int motion_type, int PMV[2][2][2], int motion_vertical_field_select[2][2], 
-  int dmvector[2], int stwtype));
+void form_predictions _ANSI_ARGS_((unsigned char *pred[], int lx[], int bx,
+  int by, int macroblock_type, int motion_type, int PMV[2][2][2],
+  int motion_vertical_field_select[2][2], int dmvector[2], int stwtype));
+void form_skipped_predictions _ANSI_ARGS_((int MBA, int n,
+  int macroblock_type, int PMV[2][2][2],
+  int motion_vertical_field_select[2][2]));
+void Initialize_Prediction _ANSI_ARGS_((void));
+void Select_Prediction_Kernels _ANSI_ARGS_((void));
 
 /* spatscal.c */
 void Spatial_Prediction _ANSI_ARGS_((void));
 
 /* store.c */
-void Write_Frame _ANSI_ARGS_((unsigned char *src[], int frame));
+void Write_Frame _ANSI_ARGS_((unsigned char *src[], int frame, long long pts));
+void Print_Output_Timing _ANSI_ARGS_((void));
 
 #ifdef DISPLAY
 /* display.c */
@@ -135,13 +196,13 @@ void Initialize_Dither_Matrix _ANSI_ARGS_((void));
 
 /* global variables */
 
-EXTERN char Version[]
+SHARED char Version[]
 #ifdef GLOBAL
   ="mpeg2decode V1.2a, 96/07/19"
 #endif
 ;
 
-EXTERN char Author[]
+SHARED char Author[]
 #ifdef GLOBAL
   ="(C) 1996, MPEG Software Simulation Group"
 #endif
@@ -149,7 +210,7 @@ EXTERN char Author[]
 
 
 /* zig-zag and alternate scan patterns */
-EXTERN unsigned char scan[2][64]
+SHARED unsigned char scan[2][64]
 #ifdef GLOBAL
 =
 {
@@ -186,7 +247,7 @@ EXTERN unsigned char scan[2][64]
 ;
 
 /* default intra quantization matrix */
-EXTERN unsigned char default_intra_quantizer_matrix[64]
+SHARED unsigned char default_intra_quantizer_matrix[64]
 #ifdef GLOBAL
 =
 {
@@ -203,7 +264,7 @@ EXTERN unsigned char default_intra_quantizer_matrix[64]
 ;
 
 /* non-linear quantization coefficient table */
-EXTERN unsigned char Non_Linear_quantizer_scale[32]
+SHARED unsigned char Non_Linear_quantizer_scale[32]
 #ifdef GLOBAL
 =
 {
@@ -230,7 +291,7 @@ EXTERN unsigned char Non_Linear_quantizer_scale[32]
 
 /* ISO/IEC 13818-2 section 6.3.6 sequence_display_extension() */
 
-EXTERN int Inverse_Table_6_9[8][4]
+SHARED int Inverse_Table_6_9[8][4]
 #ifdef GLOBAL
 =
 {
@@ -259,33 +320,42 @@ EXTERN int Inverse_Table_6_9[8][4]
 #define T_X11HIQ 5
 
 /* decoder operation control variables */
-EXTERN int Output_Type;
-EXTERN int hiQdither;
+SHARED int Output_Type;
+SHARED int hiQdither;
+SHARED int Readahead_Buffers;
+SHARED int Start_GOP;
+EXTERN int Video_Stream;
+SHARED int Program_Pids[MAX_PROGRAMS];
+SHARED int Program_Count;  /* -p PIDs, -1 for all (multi.c) */
+EXTERN int Skip_B_Pictures;
+SHARED int Output_Delay;
 
 /* decoder operation control flags */
-EXTERN int Quiet_Flag;
-EXTERN int Trace_Flag;
+SHARED int Quiet_Flag;
+SHARED int Trace_Flag;
 EXTERN int Fault_Flag;
-EXTERN int Verbose_Flag;
-EXTERN int Two_Streams;
-EXTERN int Spatial_Flag;
-EXTERN int Reference_IDCT_Flag;
-EXTERN int Frame_Store_Flag;
+SHARED int Verbose_Flag;
+SHARED int Two_Streams;
+SHARED int Spatial_Flag;
+SHARED int Reference_IDCT_Flag;
+SHARED int Frame_Store_Flag;
 EXTERN int System_Stream_Flag;
-EXTERN int Display_Progressive_Flag;
-EXTERN int Ersatz_Flag;
-EXTERN int Big_Picture_Flag;
-EXTERN int Verify_Flag;
-EXTERN int Stats_Flag;
-EXTERN int User_Data_Flag;
-EXTERN int Main_Bitstream_Flag;
+SHARED int Display_Progressive_Flag;
+SHARED int Ersatz_Flag;
+SHARED int Big_Picture_Flag;
+SHARED int Verify_Flag;
+SHARED int Stats_Flag;
+SHARED int User_Data_Flag;
+SHARED int Live_Drop_Flag;
+SHARED int Main_Bitstream_Flag;
 
 
 /* filenames */
 EXTERN char *Output_Picture_Filename;
-EXTERN char *Substitute_Picture_Filename;
-EXTERN char *Main_Bitstream_Filename; 
-EXTERN char *Enhancement_Layer_Bitstream_Filename; 
+SHARED char *Substitute_Picture_Filename;
+SHARED char *Main_Bitstream_Filename; 
+SHARED char *Enhancement_Layer_Bitstream_Filename;
+SHARED char *Index_Filename; 
 
 
 /* buffers for multiuse purposes */
@@ -306,7 +376,7 @@ EXTERN unsigned char *llframe0[3];
 EXTERN unsigned char *llframe1[3];
 
 EXTERN short *lltmp;
-EXTERN char *Lower_Layer_Picture_Filename;
+SHARED char *Lower_Layer_Picture_Filename;
 
 
 
@@ -316,10 +386,21 @@ EXTERN int Coded_Picture_Width;
 EXTERN int Coded_Picture_Height;
 EXTERN int Chroma_Width;
 EXTERN int Chroma_Height;
+/* line strides of the picture buffers, and the edge of chroma samples
+   around the picture in them (EDGE for luminance) */
+EXTERN int Coded_Picture_Stride;
+EXTERN int Chroma_Stride;
+EXTERN int Chroma_Edge_Width;
+EXTERN int Chroma_Edge_Height;
 EXTERN int block_count;
 EXTERN int Second_Field;
 EXTERN int profile, level;
 
+/* presentation and decoding time stamps (90 kHz, -1 if none) of the
+   picture being decoded, and the PTS of the reference frames */
+EXTERN long long Picture_PTS, Picture_DTS;
+EXTERN long long forward_reference_PTS, backward_reference_PTS;
+
 /* normative derived variables (as per ISO/IEC 13818-2) */
 EXTERN int horizontal_size;
 EXTERN int vertical_size;
@@ -437,15 +518,67 @@ EXTERN int broken_link;
 
 
 
+/* system layer demultiplexer counters (systems.c) */
+struct demux_stats {
+  long Packets;           /* video packets */
+  long Skipped;           /* packets of other streams, system headers */
+  long Sync_Errors;
+  long Header_Errors;
+  long Dropped;           /* transport stream: error, scrambled, duplicate */
+  long Continuity_Errors; /* transport stream */
+};
+
+/* time stamps of a video packet, until a picture claims them (systems.c) */
+#define TIMESTAMPS 8
+struct timestamp {
+  long Offset;            /* video elementary stream offset of the payload */
+  long long PTS, DTS;     /* 90 kHz, DTS -1 if absent */
+};
+
+/* what a block[] holds (getblk.c): the coefficients decoded, in rows and
+   columns of the block, anything outside of those is zero */
+struct block_coefs {
+  int Count;              /* number of coefficients */
+  int Last;               /* scan position of the last one */
+  int Rows, Cols;         /* bit k set: row / column k holds one */
+  int Sum;                /* sum of the coefficients (mismatch control) */
+};
+
+/* the quantizer matrices multiplied by one quantizer_scale, in the order
+   of a scan (getblk.c): intra, non-intra, chroma intra, chroma non-intra */
+#define QUANT_SCALES 113  /* quantizer_scale 0..112 */
+struct quant_table {
+  int Gen;                /* layer_data Quant_Gen it was built for */
+  int Scan;               /* alternate_scan it was built for */
+  int Q[4][64];
+};
+
 /* layer specific variables (needed for SNR and DP scalability) */
 EXTERN struct layer_data {
   /* bit input */
   int Infile;
   unsigned char Rdbfr[2048];
   unsigned char *Rdptr;
+  unsigned char *Rdend;   /* end of Rdbfr[] or of the mapped file */
+  unsigned char *Mapbase; /* memory mapped input (HAVE_MMAP), or NULL */
+  long Mapsize;
+  struct readahead *Ring; /* background read-ahead (readahead.c), or NULL */
+  int Live;               /* stdin or socket (live.c): 1 stream, 2 datagrams */
+  unsigned char *Rdbase;  /* start of the current buffer ... */
+  long Filepos;           /* ... and its offset in the file */
+  long Pktpos, Prevpos;   /* file offset of the current and previous video packet */
+  long Pktbase, Prevbase; /* their payload offset in the video elementary stream */
+  long Pktdata;           /* file offset of the current packet's payload */
+  int Stream_Id;          /* program stream: video stream_id, or -1 until known */
+  int Pid;                /* transport stream: video PID, or -1 until known */
+  int Pmt_Pid;            /* PID of the program map table, or -1 */
+  int Cc;                 /* last continuity_counter of Pid, or -1 */
+  struct demux_stats Demux;
+  struct timestamp Timestamp[TIMESTAMPS];
+  int Timestamps;
   unsigned char Inbfr[16];
-  /* from mpeg2play */
-  unsigned int Bfr;
+  /* from mpeg2play, widened to a 64-bit reservoir (see getbits.h) */
+  unsigned long long Bfr;
   unsigned char *Rdmax;
   int Incnt;
   int Bitcnt;
@@ -472,7 +605,18 @@ EXTERN struct layer_data {
   int priority_breakpoint;
   int quantizer_scale;
   int intra_slice;
+  /* Set_Quantizer_Scale(): the tables for quantizer_scale, and those for
+     other values, which remain valid until Quant_Gen is incremented */
+  int (*Quant)[64];
+  int Quant_Gen;
+  struct quant_table *Quant_Cache[QUANT_SCALES];
   short *block[12];
+  struct block_coefs Coefs[12];
+  /* block decoders for the current picture (getblk.c) */
+  void (*Intra_Block) _ANSI_ARGS_((int comp, int dc_dct_pred[]));
+  void (*Non_Intra_Block) _ANSI_ARGS_((int comp));
+  /* macroblock_type table for the current picture (getvlc.c) */
+  int MB_Type_Table;
 } base, enhan, *ld;
 
 
@@ -503,6 +647,9 @@ void Clear_Verify_Headers _ANSI_ARGS_((void));
 #endif /* VERIFY */
 
 
+/* inline bit reader, needs ld and System_Stream_Flag */
+#include "getbits.h"
+
 EXTERN int global_MBA;
 EXTERN int global_pic;
 EXTERN int True_Framenum;
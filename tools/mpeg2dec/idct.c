@@ -41,8 +41,18 @@
 /* this code assumes >> to be a two's-complement arithmetic */
 /* right shift: (-2)>>1 == -1 , (-3)>>1 == -2               */
 
+#include <string.h>
+
 #include "config.h"
 
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#ifdef HAVE_NEON
+#include <arm_neon.h>
+#endif
+
 #define W1 2841 /* 2048*sqrt(2)*cos(1*pi/16) */
 #define W2 2676 /* 2048*sqrt(2)*cos(2*pi/16) */
 #define W3 2408 /* 2048*sqrt(2)*cos(3*pi/16) */
@@ -52,15 +62,89 @@
 
 /* global declarations */
 void Initialize_Fast_IDCT _ANSI_ARGS_((void));
+char *Select_Fast_IDCT _ANSI_ARGS_((char *name));
 void Fast_IDCT _ANSI_ARGS_((short *block));
-
-/* private data */
-static short iclip[1024]; /* clipping table */
-static short *iclp;
+void Sparse_IDCT _ANSI_ARGS_((short *block, int rows, int cols));
+void Sparse_IDCT_Macroblock _ANSI_ARGS_((short *block[], int rows[],
+  int cols[], int n));
+void Add_Macroblock _ANSI_ARGS_((short *block[], unsigned char *pred[],
+  int pred_stride[], unsigned char *dst[], int stride[], int n));
 
 /* private prototypes */
 static void idctrow _ANSI_ARGS_((short *blk));
 static void idctcol _ANSI_ARGS_((short *blk));
+static void idctrow4 _ANSI_ARGS_((short *blk));
+static void idctcol4 _ANSI_ARGS_((short *blk));
+static void idctcol07 _ANSI_ARGS_((short *blk));
+static void idct_c _ANSI_ARGS_((short *block, int rows));
+static void idct_low_c _ANSI_ARGS_((short *block, int rows));
+static void cols07_c _ANSI_ARGS_((short *block));
+static void idct_dc _ANSI_ARGS_((short *block));
+static void idct_row0 _ANSI_ARGS_((short *block, int f77));
+static void idct_col0 _ANSI_ARGS_((short *block));
+static int full_rows _ANSI_ARGS_((short *block, int rows, int cols));
+static void add_c _ANSI_ARGS_((short *block, unsigned char *pred,
+  int pred_stride, unsigned char *dst, int stride));
+static void put_c _ANSI_ARGS_((short *block, unsigned char *dst, int stride));
+#ifdef HAVE_X86_SIMD
+static int have_sse2 _ANSI_ARGS_((void));
+static int have_avx2 _ANSI_ARGS_((void));
+static void idct_sse2 _ANSI_ARGS_((short *block, int rows));
+static void idct_avx2 _ANSI_ARGS_((short *block, int rows));
+static void idct2_avx2 _ANSI_ARGS_((short *block0, short *block1, int rows));
+static void cols07_sse2 _ANSI_ARGS_((short *block));
+static void add_sse2 _ANSI_ARGS_((short *block, unsigned char *pred,
+  int pred_stride, unsigned char *dst, int stride));
+static void put_sse2 _ANSI_ARGS_((short *block, unsigned char *dst,
+  int stride));
+#endif
+#ifdef HAVE_NEON
+static void idct_neon _ANSI_ARGS_((short *block, int rows));
+static void cols07_neon _ANSI_ARGS_((short *block));
+static void add_neon _ANSI_ARGS_((short *block, unsigned char *pred,
+  int pred_stride, unsigned char *dst, int stride));
+static void put_neon _ANSI_ARGS_((short *block, unsigned char *dst,
+  int stride));
+#endif
+
+/* implementations of Sparse_IDCT(), best last; all of them compute
+ * exactly the same, the SIMD ones transform the whole block. Blocks with
+ * only the DC coefficient, only row 0 or only column 0 are left to
+ * idct_dc(), idct_row0() and idct_col0(), which have the column pass
+ * of row 0 and 7 done by cols07. Sparse_IDCT_Macroblock() gives pairs
+ * of blocks for idct to idct2, if there is one; Add_Macroblock() stores
+ * the results with add and put.
+ */
+static struct idct_kernel
+{
+  char *name;
+  int (*usable) _ANSI_ARGS_((void)); /* NULL: on any CPU */
+  void (*idct) _ANSI_ARGS_((short *block, int rows));
+  void (*low) _ANSI_ARGS_((short *block, int rows)); /* 4x4 coefficients */
+  void (*cols07) _ANSI_ARGS_((short *block)); /* rows 0 and 7 */
+  void (*idct2) _ANSI_ARGS_((short *block0, short *block1, int rows));
+  void (*add) _ANSI_ARGS_((short *block, unsigned char *pred,
+    int pred_stride, unsigned char *dst, int stride));
+  void (*put) _ANSI_ARGS_((short *block, unsigned char *dst, int stride));
+} kernels[] =
+{
+  {"c", NULL, idct_c, idct_low_c, cols07_c, NULL, add_c, put_c},
+#ifdef HAVE_X86_SIMD
+  {"sse2", have_sse2, idct_sse2, idct_sse2, cols07_sse2, NULL,
+   add_sse2, put_sse2},
+  {"avx2", have_avx2, idct_avx2, idct_avx2, cols07_sse2, idct2_avx2,
+   add_sse2, put_sse2},
+#endif
+#ifdef HAVE_NEON
+  {"neon", NULL, idct_neon, idct_neon, cols07_neon, NULL,
+   add_neon, put_neon},
+#endif
+};
+
+/* private data */
+static THREAD_LOCAL short iclip[1024]; /* clipping table */
+static THREAD_LOCAL short *iclp;
+static THREAD_LOCAL struct idct_kernel *kernel;
 
 /* row (horizontal) IDCT
  *
@@ -188,14 +272,23 @@ short *blk;
   blk[8*7] = iclp[(x7-x1)>>14];
 }
 
-/* two dimensional inverse discrete cosine transform */
-void Fast_IDCT(block)
+/* separable IDCT: idctrow() of the rows in the bit mask rows, idctcol()
+   of all columns */
+static void idct_c(block,rows)
 short *block;
+int rows;
 {
-  int i, j, k;
+  int i;
+#ifdef TRACE_IDCT
+  int j, k;
+#endif /* TRACE_IDCT */
+
+  for (i=0; rows; i++, rows>>=1)
+    if (rows & 1)
+      idctrow(block+8*i);
 
 #ifdef TRACE_IDCT
-    printf("input to idct:\n");
+    printf("after idct_row:\n");
     for (j=0; j<8; j++) 
     {
       for (k=0; k<8; k++)
@@ -205,10 +298,1008 @@ short *block;
 #endif /* TRACE_IDCT */
 
   for (i=0; i<8; i++)
-    idctrow(block+8*i);
+    idctcol(block+i);
+}
+
+/* idctrow() of a row with blk[4..7] zero */
+static void idctrow4(blk)
+short *blk;
+{
+  int x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+  /* shortcut */
+  if (!((x3 = blk[2]) | (x4 = blk[1]) | (x7 = blk[3])))
+  {
+    blk[0]=blk[1]=blk[2]=blk[3]=blk[4]=blk[5]=blk[6]=blk[7]=blk[0]<<3;
+    return;
+  }
+
+  x0 = (blk[0]<<11) + 128; /* for proper rounding in the fourth stage */
+
+  /* first stage */
+  x5 = W7*x4;
+  x4 = x5 + (W1-W7)*x4;
+  x6 = W3*x7;
+  x7 = x6 - (W3+W5)*x7;
+
+  /* second stage */
+  x8 = x0;
+  x1 = W6*x3;
+  x2 = x1;
+  x3 = x1 + (W2-W6)*x3;
+  x1 = x4 + x6;
+  x4 -= x6;
+  x6 = x5 + x7;
+  x5 -= x7;
+
+  /* third stage */
+  x7 = x8 + x3;
+  x8 -= x3;
+  x3 = x0 + x2;
+  x0 -= x2;
+  x2 = (181*(x4+x5)+128)>>8;
+  x4 = (181*(x4-x5)+128)>>8;
+
+  /* fourth stage */
+  blk[0] = (x7+x1)>>8;
+  blk[1] = (x3+x2)>>8;
+  blk[2] = (x0+x4)>>8;
+  blk[3] = (x8+x6)>>8;
+  blk[4] = (x8-x6)>>8;
+  blk[5] = (x0-x4)>>8;
+  blk[6] = (x3-x2)>>8;
+  blk[7] = (x7-x1)>>8;
+}
+
+/* idctcol() of a column with blk[8*4..8*7] zero */
+static void idctcol4(blk)
+short *blk;
+{
+  int x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+  /* shortcut */
+  if (!((x3 = blk[8*2]) | (x4 = blk[8*1]) | (x7 = blk[8*3])))
+  {
+    blk[8*0]=blk[8*1]=blk[8*2]=blk[8*3]=blk[8*4]=blk[8*5]=blk[8*6]=blk[8*7]=
+      iclp[(blk[8*0]+32)>>6];
+    return;
+  }
+
+  x0 = (blk[8*0]<<8) + 8192;
+
+  /* first stage */
+  x8 = W7*x4 + 4;
+  x5 = x8>>3;
+  x4 = (x8+(W1-W7)*x4)>>3;
+  x8 = W3*x7 + 4;
+  x6 = x8>>3;
+  x7 = (x8-(W3+W5)*x7)>>3;
+
+  /* second stage */
+  x8 = x0;
+  x1 = W6*x3 + 4;
+  x2 = x1>>3;
+  x3 = (x1+(W2-W6)*x3)>>3;
+  x1 = x4 + x6;
+  x4 -= x6;
+  x6 = x5 + x7;
+  x5 -= x7;
+
+  /* third stage */
+  x7 = x8 + x3;
+  x8 -= x3;
+  x3 = x0 + x2;
+  x0 -= x2;
+  x2 = (181*(x4+x5)+128)>>8;
+  x4 = (181*(x4-x5)+128)>>8;
+
+  /* fourth stage */
+  blk[8*0] = iclp[(x7+x1)>>14];
+  blk[8*1] = iclp[(x3+x2)>>14];
+  blk[8*2] = iclp[(x0+x4)>>14];
+  blk[8*3] = iclp[(x8+x6)>>14];
+  blk[8*4] = iclp[(x8-x6)>>14];
+  blk[8*5] = iclp[(x0-x4)>>14];
+  blk[8*6] = iclp[(x3-x2)>>14];
+  blk[8*7] = iclp[(x7-x1)>>14];
+}
+
+/* idctcol() of a column with only blk[8*0] and blk[8*7] */
+static void idctcol07(blk)
+short *blk;
+{
+  int x0, x1, x2, x4, x5;
+
+  /* shortcut */
+  if (!(x5 = blk[8*7]))
+  {
+    blk[8*0]=blk[8*1]=blk[8*2]=blk[8*3]=blk[8*4]=blk[8*5]=blk[8*6]=blk[8*7]=
+      iclp[(blk[8*0]+32)>>6];
+    return;
+  }
 
+  x0 = (blk[8*0]<<8) + 8192;
+
+  /* first stage */
+  x4 = W7*x5 + 4;
+  x5 = (x4-(W1+W7)*x5)>>3;
+  x4 >>= 3;
+
+  /* third stage */
+  x2 = (181*(x4+x5)+128)>>8;
+  x1 = (181*(x4-x5)+128)>>8;
+
+  /* fourth stage */
+  blk[8*0] = iclp[(x0+x4)>>14];
+  blk[8*1] = iclp[(x0+x2)>>14];
+  blk[8*2] = iclp[(x0+x1)>>14];
+  blk[8*3] = iclp[(x0+x5)>>14];
+  blk[8*4] = iclp[(x0-x5)>>14];
+  blk[8*5] = iclp[(x0-x1)>>14];
+  blk[8*6] = iclp[(x0-x2)>>14];
+  blk[8*7] = iclp[(x0-x4)>>14];
+}
+
+/* idct_c() of a block with coefficients in rows and columns 0..3 only */
+static void idct_low_c(block,rows)
+short *block;
+int rows;
+{
+  int i;
+
+  for (i=0; rows; i++, rows>>=1)
+    if (rows & 1)
+      idctrow4(block+8*i);
+
+  for (i=0; i<8; i++)
+    idctcol4(block+i);
+}
+
+static void cols07_c(block)
+short *block;
+{
+  int i;
+
+  for (i=0; i<8; i++)
+    idctcol07(block+i);
+}
+
+/* only the DC coefficient: one value for the whole block */
+static void idct_dc(block)
+short *block;
+{
+  int i, v;
+  short dc;
+
+  dc = block[0]<<3; /* idctrow() */
+  v = iclp[(dc+32)>>6];
+
+  for (i=0; i<64; i++)
+    block[i] = v;
+}
+
+/* coefficients in row 0 only, but for block[63] if f77 */
+static void idct_row0(block,f77)
+short *block;
+int f77;
+{
+  idctrow(block);
+  if (f77)
+    idctrow(block+56);
+
+  kernel->cols07(block);
+}
+
+/* coefficients in column 0 only: the rows are constant and so are the
+   results of idctcol() */
+static void idct_col0(block)
+short *block;
+{
+  int i, j;
+
+  for (i=0; i<64; i+=8)
+    block[i] = block[i]<<3; /* idctrow() */
+
+  idctcol(block);
+
+  for (i=0; i<64; i+=8)
+    for (j=1; j<8; j++)
+      block[i+j] = block[i];
+}
+
+/* store an IDCT output block to the 8x8 pixels at dst, whose lines are
+   stride apart, added to the 8x8 prediction at pred, lines pred_stride
+   apart (add), or to 128 (put); the results saturate to 0..255 as
+   through Clip[] */
+static void add_c(block,pred,pred_stride,dst,stride)
+short *block;
+unsigned char *pred;
+int pred_stride;
+unsigned char *dst;
+int stride;
+{
+  int i, j, v;
+
+  for (i=0; i<8; i++)
+  {
+    for (j=0; j<8; j++)
+    {
+      v = pred[j] + block[j];
+      dst[j] = (v<0) ? 0 : ((v>255) ? 255 : v);
+    }
+    block+= 8;
+    pred+= pred_stride;
+    dst+= stride;
+  }
+}
+
+static void put_c(block,dst,stride)
+short *block;
+unsigned char *dst;
+int stride;
+{
+  int i, j, v;
+
+  for (i=0; i<8; i++)
+  {
+    for (j=0; j<8; j++)
+    {
+      v = block[j] + 128;
+      dst[j] = (v<0) ? 0 : ((v>255) ? 255 : v);
+    }
+    block+= 8;
+    dst+= stride;
+  }
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* The SIMD versions run idctrow() on eight rows and idctcol() on eight
+ * columns at a time, one 16 bit lane each, with a transpose before each
+ * pass. The products are formed with pmaddwd from pairs of coefficients,
+ * e.g. W1*x4+W7*x5 for what idctrow() computes as W7*(x4+x5)+(W1-W7)*x4;
+ * in 32 bit two's complement arithmetic both are the same. The row results
+ * are truncated to 16 bits as the stores into blk[] do, the column results
+ * are saturated as iclp[] does.
+ */
+
+static int have_sse2()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse2");
+}
+
+static int have_avx2()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+static __inline__ SIMD_TARGET("sse2") void transpose_sse2(r)
+__m128i *r;
+{
+  __m128i a0, a1, a2, a3, a4, a5, a6, a7;
+  __m128i b0, b1, b2, b3, b4, b5, b6, b7;
+
+  a0 = _mm_unpacklo_epi16(r[0],r[1]);
+  a1 = _mm_unpackhi_epi16(r[0],r[1]);
+  a2 = _mm_unpacklo_epi16(r[2],r[3]);
+  a3 = _mm_unpackhi_epi16(r[2],r[3]);
+  a4 = _mm_unpacklo_epi16(r[4],r[5]);
+  a5 = _mm_unpackhi_epi16(r[4],r[5]);
+  a6 = _mm_unpacklo_epi16(r[6],r[7]);
+  a7 = _mm_unpackhi_epi16(r[6],r[7]);
+
+  b0 = _mm_unpacklo_epi32(a0,a2);
+  b1 = _mm_unpackhi_epi32(a0,a2);
+  b2 = _mm_unpacklo_epi32(a1,a3);
+  b3 = _mm_unpackhi_epi32(a1,a3);
+  b4 = _mm_unpacklo_epi32(a4,a6);
+  b5 = _mm_unpackhi_epi32(a4,a6);
+  b6 = _mm_unpacklo_epi32(a5,a7);
+  b7 = _mm_unpackhi_epi32(a5,a7);
+
+  r[0] = _mm_unpacklo_epi64(b0,b4);
+  r[1] = _mm_unpackhi_epi64(b0,b4);
+  r[2] = _mm_unpacklo_epi64(b1,b5);
+  r[3] = _mm_unpackhi_epi64(b1,b5);
+  r[4] = _mm_unpacklo_epi64(b2,b6);
+  r[5] = _mm_unpackhi_epi64(b2,b6);
+  r[6] = _mm_unpacklo_epi64(b3,b7);
+  r[7] = _mm_unpackhi_epi64(b3,b7);
+}
+
+#define PAIR(a,b) _mm_setr_epi16(a,b,a,b,a,b,a,b)
+
+/* 181*x without a 32 bit multiply: 181 = 128+32+16+4+1 */
+static __inline__ SIMD_TARGET("sse2") __m128i mul181_sse2(x)
+__m128i x;
+{
+  return _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(x,7),_mm_slli_epi32(x,5)),
+                       _mm_add_epi32(_mm_add_epi32(_mm_slli_epi32(x,4),
+                                                   _mm_slli_epi32(x,2)),x));
+}
+
+/* idctrow() (col==0) or idctcol() (col==1) of four lanes, given the
+   coefficient pairs (0,4), (1,7), (5,3) and (2,6) of each lane */
+static __inline__ SIMD_TARGET("sse2") void idct4_sse2(p04,p17,p53,p26,col,out)
+__m128i p04, p17, p53, p26;
+int col;
+__m128i *out;
+{
+  __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, r;
+
+  /* first stage */
+  x4 = _mm_madd_epi16(p17,PAIR(W1,W7));
+  x5 = _mm_madd_epi16(p17,PAIR(W7,-W1));
+  x6 = _mm_madd_epi16(p53,PAIR(W5,W3));
+  x7 = _mm_madd_epi16(p53,PAIR(W3,-W5));
+
+  /* second stage */
+  x2 = _mm_madd_epi16(p26,PAIR(W6,-W2));
+  x3 = _mm_madd_epi16(p26,PAIR(W2,W6));
+
+  if (col)
+  {
+    r = _mm_set1_epi32(4);
+    x4 = _mm_srai_epi32(_mm_add_epi32(x4,r),3);
+    x5 = _mm_srai_epi32(_mm_add_epi32(x5,r),3);
+    x6 = _mm_srai_epi32(_mm_add_epi32(x6,r),3);
+    x7 = _mm_srai_epi32(_mm_add_epi32(x7,r),3);
+    x2 = _mm_srai_epi32(_mm_add_epi32(x2,r),3);
+    x3 = _mm_srai_epi32(_mm_add_epi32(x3,r),3);
+    r = _mm_set1_epi32(8192);
+    x8 = _mm_add_epi32(_mm_madd_epi16(p04,PAIR(256,256)),r);
+    x0 = _mm_add_epi32(_mm_madd_epi16(p04,PAIR(256,-256)),r);
+  }
+  else
+  {
+    r = _mm_set1_epi32(128);
+    x8 = _mm_add_epi32(_mm_madd_epi16(p04,PAIR(2048,2048)),r);
+    x0 = _mm_add_epi32(_mm_madd_epi16(p04,PAIR(2048,-2048)),r);
+  }
+
+  x1 = _mm_add_epi32(x4,x6);
+  x4 = _mm_sub_epi32(x4,x6);
+  x6 = _mm_add_epi32(x5,x7);
+  x5 = _mm_sub_epi32(x5,x7);
+
+  /* third stage */
+  x7 = _mm_add_epi32(x8,x3);
+  x8 = _mm_sub_epi32(x8,x3);
+  x3 = _mm_add_epi32(x0,x2);
+  x0 = _mm_sub_epi32(x0,x2);
+  r = _mm_set1_epi32(128);
+  x2 = _mm_srai_epi32(_mm_add_epi32(mul181_sse2(_mm_add_epi32(x4,x5)),r),8);
+  x4 = _mm_srai_epi32(_mm_add_epi32(mul181_sse2(_mm_sub_epi32(x4,x5)),r),8);
+
+  /* fourth stage */
+  out[0] = _mm_add_epi32(x7,x1);
+  out[1] = _mm_add_epi32(x3,x2);
+  out[2] = _mm_add_epi32(x0,x4);
+  out[3] = _mm_add_epi32(x8,x6);
+  out[4] = _mm_sub_epi32(x8,x6);
+  out[5] = _mm_sub_epi32(x0,x4);
+  out[6] = _mm_sub_epi32(x3,x2);
+  out[7] = _mm_sub_epi32(x7,x1);
+}
+
+/* one pass over all eight lanes of in[], or over lanes 0..3 if the
+   others are zero (hi4==0) */
+static __inline__ SIMD_TARGET("sse2") void idct8_sse2(in,col,hi4)
+__m128i *in;
+int col, hi4;
+{
+  __m128i lo[8], hi[8];
+  int k;
+
+  idct4_sse2(_mm_unpacklo_epi16(in[0],in[4]),_mm_unpacklo_epi16(in[1],in[7]),
+             _mm_unpacklo_epi16(in[5],in[3]),_mm_unpacklo_epi16(in[2],in[6]),
+             col,lo);
+  if (hi4)
+    idct4_sse2(_mm_unpackhi_epi16(in[0],in[4]),_mm_unpackhi_epi16(in[1],in[7]),
+               _mm_unpackhi_epi16(in[5],in[3]),_mm_unpackhi_epi16(in[2],in[6]),
+               col,hi);
+  else /* idctrow() of a zero row */
+    for (k=0; k<8; k++)
+      hi[k] = _mm_setzero_si128();
+
+  for (k=0; k<8; k++)
+    if (col)
+      in[k] = _mm_min_epi16(_mm_max_epi16(
+                _mm_packs_epi32(_mm_srai_epi32(lo[k],14),
+                                _mm_srai_epi32(hi[k],14)),
+                _mm_set1_epi16(-256)),_mm_set1_epi16(255));
+    else /* bits 8..23 sign extended: (short)(x>>8) */
+      in[k] = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(lo[k],8),16),
+                              _mm_srai_epi32(_mm_slli_epi32(hi[k],8),16));
+}
+
+static SIMD_TARGET("sse2") void idct_sse2(block,rows)
+short *block;
+int rows;
+{
+  __m128i r[8];
+  int i;
+
+  for (i=0; i<8; i++)
+    r[i] = _mm_loadu_si128((__m128i *)(block+8*i));
+
+  transpose_sse2(r);
+  idct8_sse2(r,0,rows & 0xf0);
+  transpose_sse2(r);
+  idct8_sse2(r,1,1);
+
+  for (i=0; i<8; i++)
+    _mm_storeu_si128((__m128i *)(block+8*i),r[i]);
+}
+
+/* idctcol07() of all eight columns */
+static SIMD_TARGET("sse2") void cols07_sse2(block)
+short *block;
+{
+  __m128i r0, r7, p, x0, x1, x2, x4, x5, lo[8], hi[8], *out;
+  int h, k;
+
+  r0 = _mm_loadu_si128((__m128i *)block);
+  r7 = _mm_loadu_si128((__m128i *)(block+56));
+
+  for (h=0; h<2; h++)
+  {
+    p = h ? _mm_unpackhi_epi16(r0,r7) : _mm_unpacklo_epi16(r0,r7);
+    out = h ? hi : lo;
+
+    x0 = _mm_add_epi32(_mm_madd_epi16(p,PAIR(256,0)),_mm_set1_epi32(8192));
+
+    /* first stage */
+    x4 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(p,PAIR(0,W7)),
+                                      _mm_set1_epi32(4)),3);
+    x5 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(p,PAIR(0,-W1)),
+                                      _mm_set1_epi32(4)),3);
+
+    /* third stage */
+    x2 = _mm_srai_epi32(_mm_add_epi32(mul181_sse2(_mm_add_epi32(x4,x5)),
+                                      _mm_set1_epi32(128)),8);
+    x1 = _mm_srai_epi32(_mm_add_epi32(mul181_sse2(_mm_sub_epi32(x4,x5)),
+                                      _mm_set1_epi32(128)),8);
+
+    /* fourth stage */
+    out[0] = _mm_add_epi32(x0,x4);
+    out[1] = _mm_add_epi32(x0,x2);
+    out[2] = _mm_add_epi32(x0,x1);
+    out[3] = _mm_add_epi32(x0,x5);
+    out[4] = _mm_sub_epi32(x0,x5);
+    out[5] = _mm_sub_epi32(x0,x1);
+    out[6] = _mm_sub_epi32(x0,x2);
+    out[7] = _mm_sub_epi32(x0,x4);
+  }
+
+  for (k=0; k<8; k++)
+    _mm_storeu_si128((__m128i *)(block+8*k),
+      _mm_min_epi16(_mm_max_epi16(
+        _mm_packs_epi32(_mm_srai_epi32(lo[k],14),_mm_srai_epi32(hi[k],14)),
+        _mm_set1_epi16(-256)),_mm_set1_epi16(255)));
+}
+
+/* add_c() and put_c(): packuswb saturates as Clip[] */
+static SIMD_TARGET("sse2") void add_sse2(block,pred,pred_stride,dst,stride)
+short *block;
+unsigned char *pred;
+int pred_stride;
+unsigned char *dst;
+int stride;
+{
+  __m128i v;
+  int i;
+
+  for (i=0; i<8; i++)
+  {
+    v = _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i *)pred),
+                          _mm_setzero_si128());
+    v = _mm_add_epi16(v,_mm_loadu_si128((__m128i *)(block+8*i)));
+    _mm_storel_epi64((__m128i *)dst,_mm_packus_epi16(v,v));
+    pred+= pred_stride;
+    dst+= stride;
+  }
+}
+
+static SIMD_TARGET("sse2") void put_sse2(block,dst,stride)
+short *block;
+unsigned char *dst;
+int stride;
+{
+  __m128i v;
+  int i;
+
+  for (i=0; i<8; i++)
+  {
+    v = _mm_add_epi16(_mm_loadu_si128((__m128i *)(block+8*i)),
+                      _mm_set1_epi16(128));
+    _mm_storel_epi64((__m128i *)dst,_mm_packus_epi16(v,v));
+    dst+= stride;
+  }
+}
+
+/* the same with the 32 bit arithmetic eight lanes wide */
+
+#define PAIR256(a,b) _mm256_setr_epi16(a,b,a,b,a,b,a,b,a,b,a,b,a,b,a,b)
+
+/* pairs (a[i],b[i]) of all eight lanes */
+static __inline__ SIMD_TARGET("avx2") __m256i pairs_avx2(a,b)
+__m128i a, b;
+{
+  return _mm256_inserti128_si256(
+           _mm256_castsi128_si256(_mm_unpacklo_epi16(a,b)),
+           _mm_unpackhi_epi16(a,b),1);
+}
+
+/* idct4_sse2() with four lanes in each half of the registers */
+static __inline__ SIMD_TARGET("avx2") void idct4_avx2(p04,p17,p53,p26,col,out)
+__m256i p04, p17, p53, p26;
+int col;
+__m256i *out;
+{
+  __m256i x0, x1, x2, x3, x4, x5, x6, x7, x8, r, v;
+
+  /* first stage */
+  x4 = _mm256_madd_epi16(p17,PAIR256(W1,W7));
+  x5 = _mm256_madd_epi16(p17,PAIR256(W7,-W1));
+  x6 = _mm256_madd_epi16(p53,PAIR256(W5,W3));
+  x7 = _mm256_madd_epi16(p53,PAIR256(W3,-W5));
+
+  /* second stage */
+  x2 = _mm256_madd_epi16(p26,PAIR256(W6,-W2));
+  x3 = _mm256_madd_epi16(p26,PAIR256(W2,W6));
+
+  if (col)
+  {
+    r = _mm256_set1_epi32(4);
+    x4 = _mm256_srai_epi32(_mm256_add_epi32(x4,r),3);
+    x5 = _mm256_srai_epi32(_mm256_add_epi32(x5,r),3);
+    x6 = _mm256_srai_epi32(_mm256_add_epi32(x6,r),3);
+    x7 = _mm256_srai_epi32(_mm256_add_epi32(x7,r),3);
+    x2 = _mm256_srai_epi32(_mm256_add_epi32(x2,r),3);
+    x3 = _mm256_srai_epi32(_mm256_add_epi32(x3,r),3);
+    r = _mm256_set1_epi32(8192);
+    x8 = _mm256_add_epi32(_mm256_madd_epi16(p04,PAIR256(256,256)),r);
+    x0 = _mm256_add_epi32(_mm256_madd_epi16(p04,PAIR256(256,-256)),r);
+  }
+  else
+  {
+    r = _mm256_set1_epi32(128);
+    x8 = _mm256_add_epi32(_mm256_madd_epi16(p04,PAIR256(2048,2048)),r);
+    x0 = _mm256_add_epi32(_mm256_madd_epi16(p04,PAIR256(2048,-2048)),r);
+  }
+
+  x1 = _mm256_add_epi32(x4,x6);
+  x4 = _mm256_sub_epi32(x4,x6);
+  x6 = _mm256_add_epi32(x5,x7);
+  x5 = _mm256_sub_epi32(x5,x7);
+
+  /* third stage */
+  x7 = _mm256_add_epi32(x8,x3);
+  x8 = _mm256_sub_epi32(x8,x3);
+  x3 = _mm256_add_epi32(x0,x2);
+  x0 = _mm256_sub_epi32(x0,x2);
+  r = _mm256_set1_epi32(128);
+  v = _mm256_set1_epi32(181);
+  x2 = _mm256_srai_epi32(_mm256_add_epi32(
+         _mm256_mullo_epi32(_mm256_add_epi32(x4,x5),v),r),8);
+  x4 = _mm256_srai_epi32(_mm256_add_epi32(
+         _mm256_mullo_epi32(_mm256_sub_epi32(x4,x5),v),r),8);
+
+  /* fourth stage */
+  out[0] = _mm256_add_epi32(x7,x1);
+  out[1] = _mm256_add_epi32(x3,x2);
+  out[2] = _mm256_add_epi32(x0,x4);
+  out[3] = _mm256_add_epi32(x8,x6);
+  out[4] = _mm256_sub_epi32(x8,x6);
+  out[5] = _mm256_sub_epi32(x0,x4);
+  out[6] = _mm256_sub_epi32(x3,x2);
+  out[7] = _mm256_sub_epi32(x7,x1);
+}
+
+/* the final shift of idct8_sse2(), in each half of the registers */
+static __inline__ SIMD_TARGET("avx2") __m256i pack_avx2(lo,hi,col)
+__m256i lo, hi;
+int col;
+{
+  if (col)
+    return _mm256_min_epi16(_mm256_max_epi16(
+             _mm256_packs_epi32(_mm256_srai_epi32(lo,14),
+                                _mm256_srai_epi32(hi,14)),
+             _mm256_set1_epi16(-256)),_mm256_set1_epi16(255));
+  else
+    return _mm256_packs_epi32(_mm256_srai_epi32(_mm256_slli_epi32(lo,8),16),
+                              _mm256_srai_epi32(_mm256_slli_epi32(hi,8),16));
+}
+
+static __inline__ SIMD_TARGET("avx2") void idct8_avx2(in,col)
+__m128i *in;
+int col;
+{
+  __m256i out[8], v;
+  int k;
+
+  idct4_avx2(pairs_avx2(in[0],in[4]),pairs_avx2(in[1],in[7]),
+             pairs_avx2(in[5],in[3]),pairs_avx2(in[2],in[6]),col,out);
+
+  /* two results per register, packs interleaves their halves */
+  for (k=0; k<8; k+=2)
+  {
+    v = _mm256_permute4x64_epi64(pack_avx2(out[k],out[k+1],col),0xd8);
+    in[k] = _mm256_castsi256_si128(v);
+    in[k+1] = _mm256_extracti128_si256(v,1);
+  }
+}
+
+static SIMD_TARGET("avx2") void idct_avx2(block,rows)
+short *block;
+int rows;
+{
+  __m128i r[8];
+  int i;
+
+  for (i=0; i<8; i++)
+    r[i] = _mm_loadu_si128((__m128i *)(block+8*i));
+
+  transpose_sse2(r);
+  idct8_avx2(r,0);
+  transpose_sse2(r);
+  idct8_avx2(r,1);
+
+  for (i=0; i<8; i++)
+    _mm_storeu_si128((__m128i *)(block+8*i),r[i]);
+}
+
+/* Two blocks at a time, one in each half of the registers: the unpack
+ * and pack instructions work on the halves separately, so this is
+ * transpose_sse2() and idct8_sse2() with twice as many lanes.
+ */
+
+static __inline__ SIMD_TARGET("avx2") void transpose2_avx2(r)
+__m256i *r;
+{
+  __m256i a0, a1, a2, a3, a4, a5, a6, a7;
+  __m256i b0, b1, b2, b3, b4, b5, b6, b7;
+
+  a0 = _mm256_unpacklo_epi16(r[0],r[1]);
+  a1 = _mm256_unpackhi_epi16(r[0],r[1]);
+  a2 = _mm256_unpacklo_epi16(r[2],r[3]);
+  a3 = _mm256_unpackhi_epi16(r[2],r[3]);
+  a4 = _mm256_unpacklo_epi16(r[4],r[5]);
+  a5 = _mm256_unpackhi_epi16(r[4],r[5]);
+  a6 = _mm256_unpacklo_epi16(r[6],r[7]);
+  a7 = _mm256_unpackhi_epi16(r[6],r[7]);
+
+  b0 = _mm256_unpacklo_epi32(a0,a2);
+  b1 = _mm256_unpackhi_epi32(a0,a2);
+  b2 = _mm256_unpacklo_epi32(a1,a3);
+  b3 = _mm256_unpackhi_epi32(a1,a3);
+  b4 = _mm256_unpacklo_epi32(a4,a6);
+  b5 = _mm256_unpackhi_epi32(a4,a6);
+  b6 = _mm256_unpacklo_epi32(a5,a7);
+  b7 = _mm256_unpackhi_epi32(a5,a7);
+
+  r[0] = _mm256_unpacklo_epi64(b0,b4);
+  r[1] = _mm256_unpackhi_epi64(b0,b4);
+  r[2] = _mm256_unpacklo_epi64(b1,b5);
+  r[3] = _mm256_unpackhi_epi64(b1,b5);
+  r[4] = _mm256_unpacklo_epi64(b2,b6);
+  r[5] = _mm256_unpackhi_epi64(b2,b6);
+  r[6] = _mm256_unpacklo_epi64(b3,b7);
+  r[7] = _mm256_unpackhi_epi64(b3,b7);
+}
+
+static __inline__ SIMD_TARGET("avx2") void idct8x2_avx2(in,col,hi4)
+__m256i *in;
+int col, hi4;
+{
+  __m256i lo[8], hi[8];
+  int k;
+
+  idct4_avx2(_mm256_unpacklo_epi16(in[0],in[4]),
+             _mm256_unpacklo_epi16(in[1],in[7]),
+             _mm256_unpacklo_epi16(in[5],in[3]),
+             _mm256_unpacklo_epi16(in[2],in[6]),col,lo);
+  if (hi4)
+    idct4_avx2(_mm256_unpackhi_epi16(in[0],in[4]),
+               _mm256_unpackhi_epi16(in[1],in[7]),
+               _mm256_unpackhi_epi16(in[5],in[3]),
+               _mm256_unpackhi_epi16(in[2],in[6]),col,hi);
+  else /* idctrow() of zero rows */
+    for (k=0; k<8; k++)
+      hi[k] = _mm256_setzero_si256();
+
+  for (k=0; k<8; k++)
+    in[k] = pack_avx2(lo[k],hi[k],col);
+}
+
+/* idct_avx2() of block0 and block1, rows being the rows of both */
+static SIMD_TARGET("avx2") void idct2_avx2(block0,block1,rows)
+short *block0, *block1;
+int rows;
+{
+  __m256i r[8];
+  int i;
+
+  for (i=0; i<8; i++)
+    r[i] = _mm256_inserti128_si256(
+             _mm256_castsi128_si256(_mm_loadu_si128((__m128i *)(block0+8*i))),
+             _mm_loadu_si128((__m128i *)(block1+8*i)),1);
+
+  transpose2_avx2(r);
+  idct8x2_avx2(r,0,rows & 0xf0);
+  transpose2_avx2(r);
+  idct8x2_avx2(r,1,1);
+
+  for (i=0; i<8; i++)
+  {
+    _mm_storeu_si128((__m128i *)(block0+8*i),_mm256_castsi256_si128(r[i]));
+    _mm_storeu_si128((__m128i *)(block1+8*i),_mm256_extracti128_si256(r[i],1));
+  }
+}
+
+#endif /* HAVE_X86_SIMD */
+
+#ifdef HAVE_NEON
+
+/* as the x86 versions, with widening multiply-accumulates instead of
+   pmaddwd */
+
+static __inline__ void transpose_neon(r)
+int16x8_t *r;
+{
+  int16x8x2_t t0, t1, t2, t3;
+  int32x4x2_t u0, u1, u2, u3;
+
+  t0 = vtrnq_s16(r[0],r[1]);
+  t1 = vtrnq_s16(r[2],r[3]);
+  t2 = vtrnq_s16(r[4],r[5]);
+  t3 = vtrnq_s16(r[6],r[7]);
+
+  u0 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[0]),
+                 vreinterpretq_s32_s16(t1.val[0]));
+  u1 = vtrnq_s32(vreinterpretq_s32_s16(t0.val[1]),
+                 vreinterpretq_s32_s16(t1.val[1]));
+  u2 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[0]),
+                 vreinterpretq_s32_s16(t3.val[0]));
+  u3 = vtrnq_s32(vreinterpretq_s32_s16(t2.val[1]),
+                 vreinterpretq_s32_s16(t3.val[1]));
+
+#define HALVES(a,b,get) \
+  vcombine_s16(get(vreinterpretq_s16_s32(a)),get(vreinterpretq_s16_s32(b)))
+  r[0] = HALVES(u0.val[0],u2.val[0],vget_low_s16);
+  r[1] = HALVES(u1.val[0],u3.val[0],vget_low_s16);
+  r[2] = HALVES(u0.val[1],u2.val[1],vget_low_s16);
+  r[3] = HALVES(u1.val[1],u3.val[1],vget_low_s16);
+  r[4] = HALVES(u0.val[0],u2.val[0],vget_high_s16);
+  r[5] = HALVES(u1.val[0],u3.val[0],vget_high_s16);
+  r[6] = HALVES(u0.val[1],u2.val[1],vget_high_s16);
+  r[7] = HALVES(u1.val[1],u3.val[1],vget_high_s16);
+#undef HALVES
+}
+
+/* idctrow() or idctcol() of four lanes, before the final shift */
+static __inline__ void idct4_neon(b,col,out)
+int16x4_t *b;
+int col;
+int32x4_t *out;
+{
+  int32x4_t x0, x1, x2, x3, x4, x5, x6, x7, x8, r;
+
+  /* first stage */
+  x4 = vmlal_n_s16(vmull_n_s16(b[1],W1),b[7],W7);
+  x5 = vmlsl_n_s16(vmull_n_s16(b[1],W7),b[7],W1);
+  x6 = vmlal_n_s16(vmull_n_s16(b[5],W5),b[3],W3);
+  x7 = vmlsl_n_s16(vmull_n_s16(b[5],W3),b[3],W5);
+
+  /* second stage */
+  x2 = vmlsl_n_s16(vmull_n_s16(b[2],W6),b[6],W2);
+  x3 = vmlal_n_s16(vmull_n_s16(b[2],W2),b[6],W6);
+
+  if (col)
+  {
+    r = vdupq_n_s32(4);
+    x4 = vshrq_n_s32(vaddq_s32(x4,r),3);
+    x5 = vshrq_n_s32(vaddq_s32(x5,r),3);
+    x6 = vshrq_n_s32(vaddq_s32(x6,r),3);
+    x7 = vshrq_n_s32(vaddq_s32(x7,r),3);
+    x2 = vshrq_n_s32(vaddq_s32(x2,r),3);
+    x3 = vshrq_n_s32(vaddq_s32(x3,r),3);
+    r = vdupq_n_s32(8192);
+    x8 = vaddq_s32(vmlal_n_s16(vmull_n_s16(b[0],256),b[4],256),r);
+    x0 = vaddq_s32(vmlsl_n_s16(vmull_n_s16(b[0],256),b[4],256),r);
+  }
+  else
+  {
+    r = vdupq_n_s32(128);
+    x8 = vaddq_s32(vmlal_n_s16(vmull_n_s16(b[0],2048),b[4],2048),r);
+    x0 = vaddq_s32(vmlsl_n_s16(vmull_n_s16(b[0],2048),b[4],2048),r);
+  }
+
+  x1 = vaddq_s32(x4,x6);
+  x4 = vsubq_s32(x4,x6);
+  x6 = vaddq_s32(x5,x7);
+  x5 = vsubq_s32(x5,x7);
+
+  /* third stage */
+  x7 = vaddq_s32(x8,x3);
+  x8 = vsubq_s32(x8,x3);
+  x3 = vaddq_s32(x0,x2);
+  x0 = vsubq_s32(x0,x2);
+  r = vdupq_n_s32(128);
+  x2 = vshrq_n_s32(vaddq_s32(vmulq_n_s32(vaddq_s32(x4,x5),181),r),8);
+  x4 = vshrq_n_s32(vaddq_s32(vmulq_n_s32(vsubq_s32(x4,x5),181),r),8);
+
+  /* fourth stage */
+  out[0] = vaddq_s32(x7,x1);
+  out[1] = vaddq_s32(x3,x2);
+  out[2] = vaddq_s32(x0,x4);
+  out[3] = vaddq_s32(x8,x6);
+  out[4] = vsubq_s32(x8,x6);
+  out[5] = vsubq_s32(x0,x4);
+  out[6] = vsubq_s32(x3,x2);
+  out[7] = vsubq_s32(x7,x1);
+}
+
+static __inline__ void idct8_neon(in,col,hi4)
+int16x8_t *in;
+int col, hi4;
+{
+  int16x4_t b[8];
+  int32x4_t lo[8], hi[8];
+  int k;
+
+  for (k=0; k<8; k++)
+    b[k] = vget_low_s16(in[k]);
+  idct4_neon(b,col,lo);
+  if (hi4)
+  {
+    for (k=0; k<8; k++)
+      b[k] = vget_high_s16(in[k]);
+    idct4_neon(b,col,hi);
+  }
+  else /* idctrow() of a zero row */
+    for (k=0; k<8; k++)
+      hi[k] = vdupq_n_s32(0);
+
+  for (k=0; k<8; k++)
+    if (col)
+      in[k] = vminq_s16(vmaxq_s16(vcombine_s16(vqshrn_n_s32(lo[k],14),
+                                               vqshrn_n_s32(hi[k],14)),
+                                  vdupq_n_s16(-256)),vdupq_n_s16(255));
+    else /* narrowing truncates as the stores into blk[] do */
+      in[k] = vcombine_s16(vshrn_n_s32(lo[k],8),vshrn_n_s32(hi[k],8));
+}
+
+static void idct_neon(block,rows)
+short *block;
+int rows;
+{
+  int16x8_t r[8];
+  int i;
+
+  for (i=0; i<8; i++)
+    r[i] = vld1q_s16(block+8*i);
+
+  transpose_neon(r);
+  idct8_neon(r,0,rows & 0xf0);
+  transpose_neon(r);
+  idct8_neon(r,1,1);
+
+  for (i=0; i<8; i++)
+    vst1q_s16(block+8*i,r[i]);
+}
+
+static __inline__ void cols07_neon4(r0,r7,out)
+int16x4_t r0, r7;
+int32x4_t *out;
+{
+  int32x4_t x0, x1, x2, x4, x5, r;
+
+  x0 = vaddq_s32(vshll_n_s16(r0,8),vdupq_n_s32(8192));
+
+  /* first stage */
+  r = vdupq_n_s32(4);
+  x4 = vshrq_n_s32(vaddq_s32(vmull_n_s16(r7,W7),r),3);
+  x5 = vshrq_n_s32(vaddq_s32(vmull_n_s16(r7,-W1),r),3);
+
+  /* third stage */
+  r = vdupq_n_s32(128);
+  x2 = vshrq_n_s32(vaddq_s32(vmulq_n_s32(vaddq_s32(x4,x5),181),r),8);
+  x1 = vshrq_n_s32(vaddq_s32(vmulq_n_s32(vsubq_s32(x4,x5),181),r),8);
+
+  /* fourth stage */
+  out[0] = vaddq_s32(x0,x4);
+  out[1] = vaddq_s32(x0,x2);
+  out[2] = vaddq_s32(x0,x1);
+  out[3] = vaddq_s32(x0,x5);
+  out[4] = vsubq_s32(x0,x5);
+  out[5] = vsubq_s32(x0,x1);
+  out[6] = vsubq_s32(x0,x2);
+  out[7] = vsubq_s32(x0,x4);
+}
+
+/* idctcol07() of all eight columns */
+static void cols07_neon(block)
+short *block;
+{
+  int16x8_t r0, r7;
+  int32x4_t lo[8], hi[8];
+  int k;
+
+  r0 = vld1q_s16(block);
+  r7 = vld1q_s16(block+56);
+  cols07_neon4(vget_low_s16(r0),vget_low_s16(r7),lo);
+  cols07_neon4(vget_high_s16(r0),vget_high_s16(r7),hi);
+
+  for (k=0; k<8; k++)
+    vst1q_s16(block+8*k,
+      vminq_s16(vmaxq_s16(vcombine_s16(vqshrn_n_s32(lo[k],14),
+                                       vqshrn_n_s32(hi[k],14)),
+                          vdupq_n_s16(-256)),vdupq_n_s16(255)));
+}
+
+/* add_c() and put_c(), vqmovun saturating as Clip[] */
+static void add_neon(block,pred,pred_stride,dst,stride)
+short *block;
+unsigned char *pred;
+int pred_stride;
+unsigned char *dst;
+int stride;
+{
+  int16x8_t v;
+  int i;
+
+  for (i=0; i<8; i++)
+  {
+    v = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(pred)));
+    vst1_u8(dst,vqmovun_s16(vaddq_s16(v,vld1q_s16(block+8*i))));
+    pred+= pred_stride;
+    dst+= stride;
+  }
+}
+
+static void put_neon(block,dst,stride)
+short *block;
+unsigned char *dst;
+int stride;
+{
+  int i;
+
+  for (i=0; i<8; i++)
+  {
+    vst1_u8(dst,vqmovun_s16(vaddq_s16(vld1q_s16(block+8*i),
+                                      vdupq_n_s16(128))));
+    dst+= stride;
+  }
+}
+
+#endif /* HAVE_NEON */
+
+/* two dimensional inverse discrete cosine transform */
+void Fast_IDCT(block)
+short *block;
+{
+  Sparse_IDCT(block,0xff,0xff);
+}
+
+/* Fast_IDCT() of a block that is zero outside of the rows in the bit mask
+ * rows and the columns in the bit mask cols, except for block[63] unless
+ * both row 7 and column 7 are in them: mismatch control may have set it in
+ * any block. The row transform of the other rows is zero as well, and so
+ * are the coefficients the kernels for sparse blocks leave out.
+ */
+void Sparse_IDCT(block,rows,cols)
+short *block;
+int rows, cols;
+{
+  int f77;
 #ifdef TRACE_IDCT
-    printf("after idct_row:\n");
+  int j, k;
+
+    printf("input to idct:\n");
     for (j=0; j<8; j++) 
     {
       for (k=0; k<8; k++)
@@ -217,8 +1308,18 @@ short *block;
     }
 #endif /* TRACE_IDCT */
 
-  for (i=0; i<8; i++)
-    idctcol(block+i);
+  f77 = !(rows & cols & 0x80) && block[63];
+
+  if (rows==1 && cols==1 && !f77)
+    idct_dc(block);
+  else if (rows==1)
+    idct_row0(block,f77);
+  else if (cols==1 && !f77)
+    idct_col0(block);
+  else if (!((rows|cols) & 0xf0) && !f77)
+    kernel->low(block,rows);
+  else
+    kernel->idct(block,f77 ? rows|0x80 : rows);
 
 #ifdef TRACE_IDCT
     printf("after idct_col:\n");
@@ -232,6 +1333,96 @@ short *block;
 
 }
 
+/* the rows Sparse_IDCT() gives kernel->idct() or kernel->low() for
+   block, with row 7 for F[7][7]; 0 if it uses idct_dc(), idct_row0() or
+   idct_col0() */
+static int full_rows(block,rows,cols)
+short *block;
+int rows, cols;
+{
+  int f77;
+
+  f77 = !(rows & cols & 0x80) && block[63];
+
+  if (rows==1 || (cols==1 && !f77))
+    return 0;
+
+  return f77 ? rows|0x80 : rows;
+}
+
+/* Sparse_IDCT() of the n coded blocks of a macroblock; the ones for the
+   whole-block kernel go to kernel->idct2() two at a time, if it has one */
+void Sparse_IDCT_Macroblock(block,rows,cols,n)
+short *block[];
+int rows[], cols[];
+int n;
+{
+  int i, r, pending, pending_rows;
+
+  pending = -1;
+  pending_rows = 0;
+
+  for (i=0; i<n; i++)
+  {
+    if (kernel->idct2==NULL || (r = full_rows(block[i],rows[i],cols[i]))==0)
+      Sparse_IDCT(block[i],rows[i],cols[i]);
+    else if (pending<0)
+    {
+      pending = i;
+      pending_rows = r;
+    }
+    else
+    {
+      kernel->idct2(block[pending],block[i],pending_rows|r);
+      pending = -1;
+    }
+  }
+
+  if (pending>=0)
+    kernel->idct(block[pending],pending_rows);
+}
+
+/* store the IDCT output of n blocks: block[i] goes to the 8x8 pixels at
+   dst[i], whose lines are stride[i] apart, added to the prediction at
+   pred[i], lines pred_stride[i] apart (which may be at dst[i] itself), or
+   as intra block if pred is NULL */
+void Add_Macroblock(block,pred,pred_stride,dst,stride,n)
+short *block[];
+unsigned char *pred[];
+int pred_stride[];
+unsigned char *dst[];
+int stride[];
+int n;
+{
+  int i;
+
+  if (pred==NULL)
+    for (i=0; i<n; i++)
+      kernel->put(block[i],dst[i],stride[i]);
+  else
+    for (i=0; i<n; i++)
+      kernel->add(block[i],pred[i],pred_stride[i],dst[i],stride[i]);
+}
+
+/* make Sparse_IDCT() use the implementation called name, or if name is
+   NULL the best one this CPU can run; returns the name of the one chosen,
+   NULL if the one asked for is not available */
+char *Select_Fast_IDCT(name)
+char *name;
+{
+  int i;
+
+  for (i=sizeof(kernels)/sizeof(kernels[0])-1; i>=0; i--)
+    if ((name==NULL || strcmp(name,kernels[i].name)==0) &&
+        (kernels[i].usable==NULL || kernels[i].usable()))
+    {
+      kernel = &kernels[i];
+      return kernels[i].name;
+    }
+
+  return NULL;
+}
+
 void Initialize_Fast_IDCT()
 {
   int i;
@@ -239,4 +1430,10 @@ void Initialize_Fast_IDCT()
   iclp = iclip+512;
   for (i= -512; i<512; i++)
     iclp[i] = (i<-256) ? -256 : ((i>255) ? 255 : i);
+
+#ifdef TRACE_IDCT
+  Select_Fast_IDCT("c"); /* the only one to show the row transform */
+#else
+  Select_Fast_IDCT(NULL);
+#endif /* TRACE_IDCT */
 }
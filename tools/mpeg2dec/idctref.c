@@ -69,7 +69,7 @@ void Reference_IDCT _ANSI_ARGS_((short *block));
 /* private data */
 
 /* cosine transform matrix for 8x1 IDCT */
-static double c[8][8];
+static THREAD_LOCAL double c[8][8];
 
 /* initialize DCT coefficient matrix */
 
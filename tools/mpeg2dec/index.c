@@ -0,0 +1,347 @@
+/* index.c, start code index for random access                             */
+
+
+/* Copyright (C) 1996, MPEG Software Simulation Group. All Rights Reserved. */
+
+/*
+ * Disclaimer of Warranty
+ *
+ * These software programs are available to the user without any license fee or
+ * royalty on an "as is" basis.  The MPEG Software Simulation Group disclaims
+ * any and all warranties, whether express, implied, or statuary, including any
+ * implied warranties or merchantability or of fitness for a particular
+ * purpose.  In no event shall the copyright-holder be liable for any
+ * incidental, punitive, or consequential damages of any kind whatsoever
+ * arising from the use of these programs.
+ *
+ * This disclaimer of warranty extends to the user of these programs and user's
+ * customers, employees, agents, transferees, successors, and assigns.
+ *
+ * The MPEG Software Simulation Group does not represent or warrant that the
+ * programs furnished hereunder are free of infringement of any third-party
+ * patents.
+ *
+ * Commercial implementations of MPEG-1 and MPEG-2 video, including shareware,
+ * are subject to royalty fees to patent holders.  Many of these patents are
+ * general enough such that they are unavoidable regardless of implementation
+ * design.
+ *
+ */
+
+
+/* The index lists, in stream order, the position of every sequence header,
+ * group of pictures header, picture header and slice of the main
+ * bitstream. It is built by a parse-only pass over the file that only
+ * looks at start codes and the few header fields it records, and may be
+ * kept in a text sidecar file, one entry per line:
+ *
+ *   S offset skip                                     sequence header
+ *   G offset skip drop_flag hh:mm:ss:ff closed_gop broken_link
+ *   P offset skip picture_coding_type temporal_reference
+ *   L offset skip slice_vertical_position
+ *
+ * offset is the file offset of the start code; in system streams it is
+ * the offset of the video packet holding its first byte, and skip the
+ * number of video bytes in that packet in front of it. The first line
+ * records the file size and stream type, a sidecar that does not match
+ * them is rebuilt.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "config.h"
+#include "global.h"
+
+struct index_entry {
+  int Kind;     /* 'S', 'G', 'P' or 'L' */
+  long Offset;
+  int Skip;
+  int Info[4];  /* G: drop_flag, time code (hour<<18|minute<<12|sec<<6|frame),
+                      closed_gop, broken_link
+                   P: picture_coding_type, temporal_reference
+                   L: slice_vertical_position */
+};
+
+static struct index_entry *Index;
+static int Index_Count, Index_Size;
+
+/* private prototypes */
+static void Add_Entry _ANSI_ARGS_((int kind, long offset, int skip,
+  int info0, int info1, int info2, int info3));
+static void Locate _ANSI_ARGS_((long *offset, int *skip));
+static long File_Size _ANSI_ARGS_((void));
+static void Build_Index _ANSI_ARGS_((void));
+static int Load_Index _ANSI_ARGS_((char *filename));
+static void Save_Index _ANSI_ARGS_((char *filename));
+
+static void Add_Entry(kind,offset,skip,info0,info1,info2,info3)
+int kind;
+long offset;
+int skip, info0, info1, info2, info3;
+{
+  struct index_entry *e;
+
+  if (Index_Count==Index_Size)
+  {
+    Index_Size = Index_Size ? 2*Index_Size : 1024;
+    if (!(Index = (struct index_entry *)realloc(Index,
+                                Index_Size*sizeof(struct index_entry))))
+      Error("index malloc failed\n");
+  }
+
+  e = &Index[Index_Count++];
+  e->Kind = kind;
+  e->Offset = offset;
+  e->Skip = skip;
+  e->Info[0] = info0;
+  e->Info[1] = info1;
+  e->Info[2] = info2;
+  e->Info[3] = info3;
+}
+
+/* where the start code at the front of the bit reservoir begins, in a
+ * form Seek_Bitstream() accepts; a start code may begin in the previous
+ * video packet, as the reservoir reads ahead across packets
+ */
+static void Locate(offset,skip)
+long *offset;
+int *skip;
+{
+  long pos;
+
+  pos = Bitstream_Offset(ld->Rdptr) - (ld->Incnt>>3);
+
+  if (!System_Stream_Flag)
+  {
+    *offset = pos;
+    *skip = 0;
+  }
+  else if (pos >= ld->Pktdata)
+  {
+    *offset = ld->Pktpos;
+    *skip = (int)(pos - ld->Pktdata);
+  }
+  else
+  {
+    /* video elementary stream offset, counted back into the previous packet */
+    *offset = ld->Prevpos;
+    *skip = (int)(ld->Pktbase + pos - ld->Pktdata - ld->Prevbase);
+  }
+}
+
+static long File_Size()
+{
+  struct stat st;
+
+  if (fstat(ld->Infile,&st)!=0 || !S_ISREG(st.st_mode))
+    Error("random access needs a regular bitstream file\n");
+
+  return (long)st.st_size;
+}
+
+/* index the current layer from the start of its file */
+static void Build_Index()
+{
+  unsigned int code;
+  long size, offset;
+  int skip, drop, tc, closed, broken;
+
+  size = File_Size();
+  Index_Count = 0;
+
+  Seek_Bitstream(0L,0);
+
+  for (;;)
+  {
+    Seek_Start_Code();
+
+    /* stop at end of file, i.e. in the sequence end code padding */
+    code = Show_Bits(32);
+    if (Bitstream_Offset(ld->Rdptr) - (ld->Incnt>>3) >= size
+        || (code==SEQUENCE_END_CODE && Bitstream_Padding()))
+      break;
+
+    Locate(&offset,&skip);
+    Flush_Buffer32();
+
+    switch (code)
+    {
+    case SEQUENCE_HEADER_CODE:
+      Add_Entry('S',offset,skip,0,0,0,0);
+      break;
+    case GROUP_START_CODE:
+      drop   = Get_Bits1();
+      tc     = Get_Bits(11)<<12;  /* hour, minute */
+      Flush_Buffer(1);            /* marker_bit */
+      tc    |= Get_Bits(12);      /* sec, frame */
+      closed = Get_Bits1();
+      broken = Get_Bits1();
+      Add_Entry('G',offset,skip,drop,tc,closed,broken);
+      break;
+    case PICTURE_START_CODE:
+      tc = Get_Bits(10);
+      Add_Entry('P',offset,skip,Get_Bits(3),tc,0,0);
+      break;
+    default:
+      if (code>=SLICE_START_CODE_MIN && code<=SLICE_START_CODE_MAX)
+        Add_Entry('L',offset,skip,code&255,0,0,0);
+      break;
+    }
+  }
+}
+
+/* read a sidecar index, returns 0 if it does not exist or does not match */
+static int Load_Index(filename)
+char *filename;
+{
+  FILE *fp;
+  char kind;
+  long size, offset;
+  int n, skip, systems, v[7];
+
+  if (!(fp = fopen(filename,"r")))
+    return 0;
+
+  if (fscanf(fp,"mpeg2decode index %ld %d\n",&size,&systems)!=2
+      || size!=File_Size() || systems!=System_Stream_Flag)
+  {
+    fclose(fp);
+    return 0;
+  }
+
+  Index_Count = 0;
+
+  while (fscanf(fp," %c %ld %d",&kind,&offset,&skip)==3)
+  {
+    n = 0;
+    switch (kind)
+    {
+    case 'S':
+      Add_Entry('S',offset,skip,0,0,0,0);
+      break;
+    case 'G':
+      n = fscanf(fp,"%d %d:%d:%d:%d %d %d",&v[0],&v[1],&v[2],&v[3],&v[4],&v[5],&v[6]);
+      if (n==7)
+        Add_Entry('G',offset,skip,v[0],(v[1]<<18)|(v[2]<<12)|(v[3]<<6)|v[4],v[5],v[6]);
+      break;
+    case 'P':
+      n = fscanf(fp,"%d %d",&v[0],&v[1]);
+      if (n==2)
+        Add_Entry('P',offset,skip,v[0],v[1],0,0);
+      break;
+    case 'L':
+      n = fscanf(fp,"%d",&v[0]);
+      if (n==1)
+        Add_Entry('L',offset,skip,v[0],0,0,0);
+      break;
+    }
+  }
+
+  n = feof(fp);
+  fclose(fp);
+
+  return n;
+}
+
+static void Save_Index(filename)
+char *filename;
+{
+  FILE *fp;
+  struct index_entry *e;
+  int i;
+
+  if (!(fp = fopen(filename,"w")))
+  {
+    sprintf(Error_Text,"Couldn't create index file %s\n",filename);
+    Error(Error_Text);
+  }
+
+  fprintf(fp,"mpeg2decode index %ld %d\n",File_Size(),System_Stream_Flag);
+
+  for (i=0; i<Index_Count; i++)
+  {
+    e = &Index[i];
+    fprintf(fp,"%c %ld %d",e->Kind,e->Offset,e->Skip);
+    switch (e->Kind)
+    {
+    case 'G':
+      fprintf(fp," %d %02d:%02d:%02d:%02d %d %d",e->Info[0],
+        e->Info[1]>>18,(e->Info[1]>>12)&63,(e->Info[1]>>6)&63,e->Info[1]&63,
+        e->Info[2],e->Info[3]);
+      break;
+    case 'P':
+      fprintf(fp," %d %d",e->Info[0],e->Info[1]);
+      break;
+    case 'L':
+      fprintf(fp," %d",e->Info[0]);
+      break;
+    }
+    fputc('\n',fp);
+  }
+
+  if (fclose(fp))
+  {
+    sprintf(Error_Text,"Couldn't write index file %s\n",filename);
+    Error(Error_Text);
+  }
+}
+
+/* index the main bitstream (-k) */
+void Write_Index(filename)
+char *filename;
+{
+  Build_Index();
+  Save_Index(filename);
+
+  if (!Quiet_Flag)
+    fprintf(stderr,"%d index entries written to %s\n",Index_Count,filename);
+}
+
+/* position the current layer at group of pictures Gop (counted from 0)
+ * of the index, with the state of the sequence header in front of it
+ * (-s); the index is read from filename, or built (and saved there)
+ */
+void Seek_GOP(filename,Gop)
+char *filename;
+int Gop;
+{
+  int i, seq, n;
+
+  if (filename==NULL || !Load_Index(filename))
+  {
+    Build_Index();
+    if (filename!=NULL)
+      Save_Index(filename);
+  }
+
+  seq = -1;
+  n = 0;
+  for (i=0; i<Index_Count; i++)
+  {
+    if (Index[i].Kind=='S')
+      seq = i;
+    else if (Index[i].Kind=='G' && n++==Gop)
+      break;
+  }
+
+  if (i==Index_Count)
+  {
+    sprintf(Error_Text,"group of pictures %d not found (%d in index)\n",Gop,n);
+    Error(Error_Text);
+  }
+  if (seq<0)
+    Error("no sequence header in front of group of pictures\n");
+
+  Seek_Bitstream(Index[seq].Offset,Index[seq].Skip);
+  if (!Get_Sequence_Header())
+    Error("sequence header not found at index position, stale index?\n");
+
+  Seek_Bitstream(Index[i].Offset,Index[i].Skip);
+
+  /* leading B pictures of an open GOP refer to the previous GOP */
+  Skip_B_Pictures = (Index[i].Info[2] && !Index[i].Info[3]) ? 0 : 2;
+}
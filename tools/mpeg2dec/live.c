@@ -0,0 +1,184 @@
+/* live.c, live input from stdin, UDP and TCP sockets                      */
+
+
+/* Copyright (C) 1996, MPEG Software Simulation Group. All Rights Reserved. */
+
+/*
+ * Disclaimer of Warranty
+ *
+ * These software programs are available to the user without any license fee or
+ * royalty on an "as is" basis.  The MPEG Software Simulation Group disclaims
+ * any and all warranties, whether express, implied, or statuary, including any
+ * implied warranties or merchantability or of fitness for a particular
+ * purpose.  In no event shall the copyright-holder be liable for any
+ * incidental, punitive, or consequential damages of any kind whatsoever
+ * arising from the use of these programs.
+ *
+ * This disclaimer of warranty extends to the user of these programs and user's
+ * customers, employees, agents, transferees, successors, and assigns.
+ *
+ * The MPEG Software Simulation Group does not represent or warrant that the
+ * programs furnished hereunder are free of infringement of any third-party
+ * patents.
+ *
+ * Commercial implementations of MPEG-1 and MPEG-2 video, including shareware,
+ * are subject to royalty fees to patent holders.  Many of these patents are
+ * general enough such that they are unavoidable regardless of implementation
+ * design.
+ *
+ */
+
+
+/* Names of the form
+ *
+ *   -                standard input
+ *   udp:port         datagrams sent to port (on any local address)
+ *   udp:host:port    datagrams sent to host:port, host a local or
+ *                    multicast address
+ *   tcp:port         the first connection accepted on port
+ *   tcp:host:port    a connection to host:port
+ *
+ * select live input instead of a file, e.g. the PES data connection of a
+ * vdr streamdev server (doc/HOWTO-vdr-streamdev: "PORT 0 192,168,153,9,64,1"
+ * asks the server to connect to 192.168.153.9 port 64*256+1, which is
+ * -b tcp:16385 here). Live input cannot seek; it is read through the
+ * read-ahead ring (readahead.c) when compiled with HAVE_PTHREAD.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#include "config.h"
+#include "global.h"
+
+/* private prototypes */
+static int Open_Socket _ANSI_ARGS_((char *Address, int Type));
+
+/* resolve [host:]port and bind (UDP, or TCP without host: listen and
+ * accept) or connect (TCP with host) a socket of Type
+ */
+static int Open_Socket(Address,Type)
+char *Address;
+int Type;
+{
+  char Host[256], *Port;
+  struct addrinfo hints, *res, *ai;
+  struct ip_mreq mreq;
+  int s, c, on;
+
+  if ((Port = strrchr(Address,':'))!=NULL)
+  {
+    if (Port-Address >= (int)sizeof(Host))
+      return -1;
+    memcpy(Host,Address,Port-Address);
+    Host[Port-Address] = '\0';
+    Port++;
+  }
+  else
+    Port = Address;
+
+  memset(&hints,0,sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = Type;
+  if (Type==SOCK_DGRAM || Port==Address)
+    hints.ai_flags = AI_PASSIVE;
+
+  if (getaddrinfo(Port==Address ? NULL : Host,Port,&hints,&res))
+    return -1;
+
+  s = -1;
+  for (ai=res; ai!=NULL && s<0; ai=ai->ai_next)
+  {
+    if ((s = socket(ai->ai_family,ai->ai_socktype,ai->ai_protocol))<0)
+      continue;
+
+    if (Type==SOCK_STREAM && Port!=Address)
+    {
+      if (connect(s,ai->ai_addr,ai->ai_addrlen)==0)
+        break;
+    }
+    else
+    {
+      on = 1;
+      setsockopt(s,SOL_SOCKET,SO_REUSEADDR,(char *)&on,sizeof(on));
+      /* datagrams that arrive while the reader thread waits for the
+         decoder are lost once the socket buffer is full */
+      if (Type==SOCK_DGRAM)
+      {
+        on = 1<<20;
+        setsockopt(s,SOL_SOCKET,SO_RCVBUF,(char *)&on,sizeof(on));
+      }
+      if (bind(s,ai->ai_addr,ai->ai_addrlen)==0)
+      {
+        /* receive from a multicast group, on the default interface */
+        if (Type==SOCK_DGRAM && ai->ai_family==AF_INET
+            && IN_MULTICAST(ntohl(((struct sockaddr_in *)ai->ai_addr)->sin_addr.s_addr)))
+        {
+          mreq.imr_multiaddr = ((struct sockaddr_in *)ai->ai_addr)->sin_addr;
+          mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+          setsockopt(s,IPPROTO_IP,IP_ADD_MEMBERSHIP,(char *)&mreq,sizeof(mreq));
+        }
+        break;
+      }
+    }
+
+    close(s);
+    s = -1;
+  }
+  freeaddrinfo(res);
+
+  if (s<0 || Type==SOCK_DGRAM || Port!=Address)
+    return s;
+
+  /* wait for the sender */
+  if (!Quiet_Flag)
+    fprintf(stderr,"waiting for a connection on TCP port %s\n",Port);
+
+  if (listen(s,1)<0 || (c = accept(s,NULL,NULL))<0)
+  {
+    close(s);
+    return -1;
+  }
+  close(s);
+
+  return c;
+}
+
+/* open Filename as live input, see above; returns the file descriptor,
+ * -1 if it cannot be opened, or -2 if Filename does not name live input.
+ * Sets ld->Live to 1 for byte streams and 2 for datagrams.
+ */
+int Open_Live_Input(Filename)
+char *Filename;
+{
+  int Infile;
+
+  if (strcmp(Filename,"-")==0)
+  {
+    ld->Live = 1;
+    return 0;
+  }
+
+  if (strncmp(Filename,"udp:",4)==0)
+  {
+    if ((Infile = Open_Socket(Filename+4,SOCK_DGRAM))>=0)
+      ld->Live = 2;
+    return Infile;
+  }
+
+  if (strncmp(Filename,"tcp:",4)==0)
+  {
+    if ((Infile = Open_Socket(Filename+4,SOCK_STREAM))>=0)
+      ld->Live = 1;
+    return Infile;
+  }
+
+  return -2;
+}
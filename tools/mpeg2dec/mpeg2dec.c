@@ -30,6 +30,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 #include <fcntl.h>
 #ifdef PROFILE
@@ -42,11 +43,11 @@
 
 /* private prototypes */
 static int  video_sequence _ANSI_ARGS_((int *framenum));
-static int Decode_Bitstream _ANSI_ARGS_((void));
 static int  Headers _ANSI_ARGS_((void));
 static void Initialize_Sequence _ANSI_ARGS_((void));
-static void Initialize_Decoder _ANSI_ARGS_((void));
 static void Deinitialize_Sequence _ANSI_ARGS_((void));
+static unsigned char *Allocate_Picture_Buffer _ANSI_ARGS_((int cc));
+static int  Edge_Offset _ANSI_ARGS_((int cc));
 static void Process_Options _ANSI_ARGS_((int argc, char *argv[]));
 
 
@@ -60,6 +61,9 @@ static void Clear_Options();
 #ifdef DEBUG
 static void Print_Options();
 #endif
+#ifdef HAVE_PTHREAD
+static void Probe_Live_Input _ANSI_ARGS_((void));
+#endif
 
 int main(argc,argv)
 int argc;
@@ -79,60 +83,92 @@ char *argv[];
   Print_Options();
 #endif
 
+  /* constant tables, shared by all decoding threads */
+  Initialize_DCT_Tables();
+  Initialize_VLC_Tables();
+
   ld = &base; /* select base layer context */
 
   /* open MPEG base layer bitstream file(s) */
   /* NOTE: this is either a base layer stream or a spatial enhancement stream */
-  if ((base.Infile=open(Main_Bitstream_Filename,O_RDONLY|O_BINARY))<0)
+  if ((base.Infile=Open_Bitstream(Main_Bitstream_Filename))<0)
   {
     fprintf(stderr,"Base layer input file %s not found\n", Main_Bitstream_Filename);
     exit(1);
   }
 
 
-  if(base.Infile != 0)
+  if (base.Live)
+  {
+#ifdef HAVE_PTHREAD
+    /* live input cannot be rewound: probe it in the read-ahead ring */
+    Start_Readahead(Readahead_Buffers);
+    Probe_Live_Input();
+#else /* HAVE_PTHREAD */
+    Error("live input needs the read-ahead thread (HAVE_PTHREAD)\n");
+#endif /* HAVE_PTHREAD */
+  }
+  else if(base.Infile != 0)
   {
     Initialize_Buffer(); 
   
-    if(Show_Bits(8)==0x47)
+    if(Show_Bits(8)==TRANSPORT_SYNC_BYTE)
+      System_Stream_Flag = TRANSPORT_STREAM;
+    else
     {
-      sprintf(Error_Text,"Decoder currently does not parse transport streams\n");
-      Error(Error_Text);
-    }
-
-    next_start_code();
-    code = Show_Bits(32);
+      next_start_code();
+      code = Show_Bits(32);
 
-    switch(code)
-    {
-    case SEQUENCE_HEADER_CODE:
-      break;
-    case PACK_START_CODE:
-    case VIDEO_ELEMENTARY_STREAM:
-      System_Stream_Flag = 1;
-      break;
-    default:
-      sprintf(Error_Text,"Unable to recognize stream type\n");
-      Error(Error_Text);
-      break;
+      switch(code)
+      {
+      case SEQUENCE_HEADER_CODE:
+        break;
+      case PACK_START_CODE:
+        System_Stream_Flag = PROGRAM_STREAM;
+        break;
+      default:
+        if ((code & 0xfffffff0)==VIDEO_ELEMENTARY_STREAM)
+        {
+          System_Stream_Flag = PROGRAM_STREAM;
+          break;
+        }
+        sprintf(Error_Text,"Unable to recognize stream type\n");
+        Error(Error_Text);
+        break;
+      }
     }
 
     lseek(base.Infile, 0l, 0);
     Initialize_Buffer(); 
   }
 
-  if(base.Infile!=0)
+  if(base.Infile!=0 && !base.Live)
   {
     lseek(base.Infile, 0l, 0);
   }
 
+#ifdef HAVE_PTHREAD
+  if (Readahead_Buffers && !base.Live)
+    Start_Readahead(Readahead_Buffers);
+#endif /* HAVE_PTHREAD */
+
+#ifdef HAVE_PTHREAD
+  /* several programs of a transport stream, each on its own thread */
+  if (Program_Count>1 || Program_Count<0)
+  {
+    ret = Decode_Programs();
+    Close_Bitstream();
+    return ret;
+  }
+#endif /* HAVE_PTHREAD */
+
   Initialize_Buffer(); 
 
   if(Two_Streams)
   {
     ld = &enhan; /* select enhancement layer context */
 
-    if ((enhan.Infile = open(Enhancement_Layer_Bitstream_Filename,O_RDONLY|O_BINARY))<0)
+    if ((enhan.Infile = Open_Bitstream(Enhancement_Layer_Bitstream_Filename))<0)
     {
       sprintf(Error_Text,"enhancment layer bitstream file %s not found\n",
         Enhancement_Layer_Bitstream_Filename);
@@ -140,24 +176,104 @@ char *argv[];
       Error(Error_Text);
     }
 
+#ifdef HAVE_PTHREAD
+    if (Readahead_Buffers || enhan.Live)
+      Start_Readahead(Readahead_Buffers);
+#else /* HAVE_PTHREAD */
+    if (enhan.Live)
+      Error("live input needs the read-ahead thread (HAVE_PTHREAD)\n");
+#endif /* HAVE_PTHREAD */
+
     Initialize_Buffer();
     ld = &base;
   }
 
+  /* parse-only pass that writes the start code index (-k) */
+  if (Index_Filename!=NULL && Start_GOP<0)
+  {
+    Write_Index(Index_Filename);
+    Close_Bitstream();
+    return 0;
+  }
+
+  /* random access (-s) */
+  if (Start_GOP>=0)
+  {
+    if (Two_Streams)
+      Error("-s is not supported with an enhancement layer\n");
+    Seek_GOP(Index_Filename,Start_GOP);
+  }
+
+  /* live input may start anywhere */
+  if (base.Live)
+    Join_Sequence();
+
   Initialize_Decoder();
 
   ret = Decode_Bitstream();
 
-  close(base.Infile);
+  ld = &base;
+  if (System_Stream_Flag && !Quiet_Flag)
+    Print_Demux_Statistics();
+  if (!Quiet_Flag)
+    Print_Output_Timing();
+  Close_Bitstream();
 
   if (Two_Streams)
-    close(enhan.Infile);
+  {
+    ld = &enhan;
+    Close_Bitstream();
+  }
 
   return 0;
 }
 
+#ifdef HAVE_PTHREAD
+/* stream type of live input from its first bytes, which stay in the
+   read-ahead ring: as many as Buffer holds, or as have come in once the
+   ring is full; transport packets need not be aligned to the start */
+static void Probe_Live_Input()
+{
+  unsigned char Buffer[4096];
+  int i, n, code;
+
+  n = Peek_Readahead(Buffer,sizeof(Buffer));
+
+  for (i=0; i<TRANSPORT_PACKET_SIZE && i+2*TRANSPORT_PACKET_SIZE<n; i++)
+    if (Buffer[i]==TRANSPORT_SYNC_BYTE
+        && Buffer[i+TRANSPORT_PACKET_SIZE]==TRANSPORT_SYNC_BYTE
+        && Buffer[i+2*TRANSPORT_PACKET_SIZE]==TRANSPORT_SYNC_BYTE)
+    {
+      System_Stream_Flag = TRANSPORT_STREAM;
+      Transport_Readahead();
+      return;
+    }
+
+  /* packs or PES packets (vdr) rather than video start codes, which
+     cannot be emulated within video data; the input may start within
+     a packet */
+  code = 0;
+  for (i=0; i+3<n; i++)
+    if (Buffer[i]==0 && Buffer[i+1]==0 && Buffer[i+2]==1)
+    {
+      code = 0x100 | Buffer[i+3];
+      if (code>=PACK_START_CODE)
+      {
+        System_Stream_Flag = PROGRAM_STREAM;
+        return;
+      }
+    }
+
+  if (code==0)
+  {
+    sprintf(Error_Text,"Unable to recognize stream type\n");
+    Error(Error_Text);
+  }
+}
+#endif /* HAVE_PTHREAD */
+
 /* IMPLEMENTAION specific rouintes */
-static void Initialize_Decoder()
+void Initialize_Decoder()
 {
   int i;
 
@@ -165,17 +281,22 @@ static void Initialize_Decoder()
   if (!(Clip=(unsigned char *)malloc(1024)))
     Error("Clip[] malloc failed\n");
 
+  Picture_PTS = Picture_DTS = -1;
+  forward_reference_PTS = backward_reference_PTS = -1;
+
   Clip += 384;
 
   for (i=-384; i<640; i++)
     Clip[i] = (i<0) ? 0 : ((i>255) ? 255 : i);
 
-  /* IDCT */
+  /* IDCT, whose fast version's kernels also store the blocks
+     (Add_Macroblock()) */
   if (Reference_IDCT_Flag)
     Initialize_Reference_IDCT();
-  else
-    Initialize_Fast_IDCT();
+  Initialize_Fast_IDCT();
 
+  /* motion compensation */
+  Initialize_Prediction();
 }
 
 /* mostly IMPLEMENTAION specific rouintes */
@@ -218,6 +339,16 @@ static void Initialize_Sequence()
   /* derived based on Table 6-20 in ISO/IEC 13818-2 section 6.3.17 */
   block_count = Table_6_20[chroma_format-1];
 
+  /* motion compensation kernels for the block sizes of this chroma format */
+  Select_Prediction_Kernels();
+
+  /* the picture buffers have an edge of EDGE luminance samples, and of
+     as many chroma samples as cover the same area */
+  Chroma_Edge_Width = (chroma_format==CHROMA444) ? EDGE : EDGE>>1;
+  Chroma_Edge_Height = (chroma_format!=CHROMA420) ? EDGE : EDGE>>1;
+  Coded_Picture_Stride = Coded_Picture_Width + 2*EDGE;
+  Chroma_Stride = Chroma_Width + 2*Chroma_Edge_Width;
+
   for (cc=0; cc<3; cc++)
   {
     if (cc==0)
@@ -225,13 +356,13 @@ static void Initialize_Sequence()
     else
       size = Chroma_Width*Chroma_Height;
 
-    if (!(backward_reference_frame[cc] = (unsigned char *)malloc(size)))
+    if (!(backward_reference_frame[cc] = Allocate_Picture_Buffer(cc)))
       Error("backward_reference_frame[] malloc failed\n");
 
-    if (!(forward_reference_frame[cc] = (unsigned char *)malloc(size)))
+    if (!(forward_reference_frame[cc] = Allocate_Picture_Buffer(cc)))
       Error("forward_reference_frame[] malloc failed\n");
 
-    if (!(auxframe[cc] = (unsigned char *)malloc(size)))
+    if (!(auxframe[cc] = Allocate_Picture_Buffer(cc)))
       Error("auxframe[] malloc failed\n");
 
     if(Ersatz_Flag)
@@ -267,6 +398,9 @@ void Error(text)
 char *text;
 {
   fprintf(stderr,text);
+#ifdef HAVE_PTHREAD
+  End_Program(); /* returns unless in a decoding thread of multi.c */
+#endif /* HAVE_PTHREAD */
   exit(1);
 }
 
@@ -287,15 +421,19 @@ int argc;                  /* argument count  */
 char *argv[];              /* argument vector */
 {
   int i, LastArg, NextArg;
+  char *p;
   for (i = 0; i < 12; i++) {	/* allocate page-aligned blocks */
-    if ((base.block[i] = valloc(64)) == 0) {
+    if ((base.block[i] = valloc(64*sizeof(short))) == 0) {
 	fprintf(stderr, "out of memory\n");
 	exit(1);
     }
-    if ((enhan.block[i] = valloc(64)) == 0) {
+    if ((enhan.block[i] = valloc(64*sizeof(short))) == 0) {
 	fprintf(stderr, "out of memory\n");
 	exit(1);
     }
+    /* Clear_Block() only clears the rows that were written to */
+    memset(base.block[i],0,64*sizeof(short));
+    memset(enhan.block[i],0,64*sizeof(short));
   }
 
   /* at least one argument should be present */
@@ -303,21 +441,36 @@ char *argv[];              /* argument vector */
   {
     printf("\n%s, %s\n",Version,Author);
     printf("Usage:  mpeg2decode {options}\n\
-Options: -b  file  main bitstream (base or spatial enhancement layer)\n\
+Options: -an       read ahead on a separate thread (n: 1 MB buffers, default 4;\n\
+                   live input: 128 KB buffers, default 16)\n\
+         -b  file  main bitstream (base or spatial enhancement layer)\n\
          -cn file  conformance report (n: level)\n\
+         -d        live input: drop data to the next start code (transport\n\
+                   stream: packet) when the decoder falls behind\n\
+                   (default: stop reading)\n\
          -e  file  enhancement layer bitstream (SNR or Data Partitioning)\n\
          -f        store/display interlaced video in frame format\n\
          -g        concatenated file format for substitution method (-x)\n\
          -in file  information & statistics report  (n: level)\n\
+         -k  file  start code index: write it, or read it for -s\n\
          -l  file  file name pattern for lower layer sequence\n\
                    (for spatial scalability)\n\
          -on file  output format (0:YUV 1:SIF 2:TGA 3:PPM 4:X11 5:X11HiQ)\n\
+         -pn       video stream: PID of a transport stream (default: first\n\
+                   in PMT), stream_id of a program stream (default: first)\n\
+         -pn,n...  transport stream: decode these video PIDs in parallel,\n\
+                   output file names prefixed with the PID (-pall: all)\n\
          -q        disable warnings to stderr\n\
          -r        use double precision reference IDCT\n\
+         -sn       start at group of pictures n (counted from 0)\n\
          -t        enable low level tracing to stdout\n\
          -u  file  print user_data to stdio or file\n\
          -vn       verbose output (n: level)\n\
+         -wn       pace output to the presentation time stamps, n ms after\n\
+                   the first frame (default 0), and report early/late frames\n\
          -x  file  filename pattern of picture substitution sequence\n\n\
+Live input:     file - (stdin), udp:[host:]port, tcp:port (accept),\n\
+                 tcp:host:port (connect)\n\
 File patterns:  for sequential filenames, \"printf\" style, e.g. rec%%d\n\
                  or rec%%d%%c for fieldwise storage\n\
 Levels:        0:none 1:sequence 2:picture 3:slice 4:macroblock 5:block\n\n\
@@ -340,7 +493,7 @@ Example:       mpeg2decode -b bitstream.mpg -f -r -o0 rec%%d\n\
     /* parse ahead to see if another flag immediately follows current
        argument (this is used to tell if a filename is missing) */
     if(!LastArg)
-      NextArg = (argv[i+1][0]=='-');
+      NextArg = (argv[i+1][0]=='-' && argv[i+1][1]!='\0'); /* "-": stdin */
     else
       NextArg = 0;
 
@@ -350,6 +503,16 @@ Example:       mpeg2decode -b bitstream.mpg -f -r -o0 rec%%d\n\
       switch(toupper(argv[i][1]))
       {
         /* third character. [2], is the value */
+      case 'A':
+#ifdef HAVE_PTHREAD
+        Readahead_Buffers = atoi(&argv[i][2]);
+        if (Readahead_Buffers<=0)
+          Readahead_Buffers = 4;
+#else /* HAVE_PTHREAD */
+        printf("WARNING: This program not compiled for -a option\n");
+#endif /* HAVE_PTHREAD */
+        break;
+
       case 'B':
         Main_Bitstream_Flag = 1;
 
@@ -379,6 +542,10 @@ Example:       mpeg2decode -b bitstream.mpg -f -r -o0 rec%%d\n\
 #endif /* VERIFY */
         break;
 
+      case 'D':
+        Live_Drop_Flag = 1;
+        break;
+
       case 'E':
         Two_Streams = 1; /* either Data Partitioning (DP) or SNR Scalability enhancment */
 	                   
@@ -410,6 +577,17 @@ Example:       mpeg2decode -b bitstream.mpg -f -r -o0 rec%%d\n\
 #endif /* VERIFY */     
         break;
     
+      case 'K':
+        if(NextArg || LastArg)
+        {
+          printf("ERROR: -k must be followed by filename\n");
+          exit(ERROR);
+        }
+        else
+          Index_Filename = argv[++i];
+
+        break;
+
       case 'L':  /* spatial scalability flag */
         Spatial_Flag = 1;
 
@@ -447,6 +625,27 @@ Example:       mpeg2decode -b bitstream.mpg -f -r -o0 rec%%d\n\
 #endif /* DISPLAY */
         break;
 
+      case 'P':
+        /* PID list or "all": several programs, see multi.c */
+        if (strcmp(&argv[i][2],"all")==0)
+        {
+          Program_Count = -1;
+          break;
+        }
+        p = &argv[i][2];
+        do
+        {
+          Video_Stream = (int)strtol(p,&p,0);
+          if (Video_Stream<=PAT_PID || Video_Stream>=NULL_PID || Program_Count==MAX_PROGRAMS)
+          {
+            printf("ERROR: -p PID or stream_id (%d) out of range\n",Video_Stream);
+            exit(ERROR);
+          }
+          Program_Pids[Program_Count++] = Video_Stream;
+        } while (*p++==',');
+        Video_Stream = Program_Pids[0];
+        break;
+
       case 'Q':
         Quiet_Flag = 1;
         break;
@@ -455,6 +654,12 @@ Example:       mpeg2decode -b bitstream.mpg -f -r -o0 rec%%d\n\
         Reference_IDCT_Flag = 1;
         break;
     
+      case 'S':
+        Start_GOP = atoi(&argv[i][2]);
+        if (Start_GOP<0)
+          Start_GOP = 0;
+        break;
+
       case 'T':
 #ifdef TRACE
         Trace_Flag = 1;
@@ -474,6 +679,12 @@ Example:       mpeg2decode -b bitstream.mpg -f -r -o0 rec%%d\n\
 #endif /* VERBOSE */
         break;
 
+      case 'W':
+        Output_Delay = atoi(&argv[i][2]);
+        if (Output_Delay<0)
+          Output_Delay = 0;
+        break;
+
 
       case 'X':
         Ersatz_Flag = 1;
@@ -609,7 +820,7 @@ static int Headers()
 
 
 
-static int Decode_Bitstream()
+int Decode_Bitstream()
 {
   int ret;
   int Bitstream_Framenum;
@@ -636,6 +847,35 @@ static int Decode_Bitstream()
 }
 
 
+/* a picture buffer of component cc, pointing at the top left sample of the
+   picture in it, or NULL */
+static unsigned char *Allocate_Picture_Buffer(cc)
+int cc;
+{
+  unsigned char *buf;
+  int size;
+
+  if (cc==0)
+    size = Coded_Picture_Stride*(Coded_Picture_Height + 2*EDGE);
+  else
+    size = Chroma_Stride*(Chroma_Height + 2*Chroma_Edge_Height);
+
+  if (!(buf = (unsigned char *)malloc(size)))
+    return NULL;
+
+  return buf + Edge_Offset(cc);
+}
+
+/* the samples in a picture buffer of component cc before the picture */
+static int Edge_Offset(cc)
+int cc;
+{
+  if (cc==0)
+    return EDGE*Coded_Picture_Stride + EDGE;
+  else
+    return Chroma_Edge_Height*Chroma_Stride + Chroma_Edge_Width;
+}
+
 static void Deinitialize_Sequence()
 {
   int i;
@@ -645,9 +885,9 @@ static void Deinitialize_Sequence()
 
   for(i=0;i<3;i++)
   {
-    free(backward_reference_frame[i]);
-    free(forward_reference_frame[i]);
-    free(auxframe[i]);
+    free(backward_reference_frame[i] - Edge_Offset(i));
+    free(forward_reference_frame[i] - Edge_Offset(i));
+    free(auxframe[i] - Edge_Offset(i));
 
     if (base.scalable_mode==SC_SPAT)
     {
@@ -744,6 +984,14 @@ static void Clear_Options()
   Verify_Flag = 0;
   Stats_Flag  = 0;
   User_Data_Flag = 0; 
+  Readahead_Buffers = 0;
+  Live_Drop_Flag = 0;
+  Output_Delay = -1;
+  Index_Filename = NULL;
+  Start_GOP = -1;
+  Video_Stream = -1;
+  Program_Count = 0;
+  Skip_B_Pictures = 0;
 }
 
 
@@ -772,6 +1020,13 @@ static void Print_Options()
   printf("Verify_Flag                          = %d\n", Verify_Flag);
   printf("Stats_Flag                           = %d\n", Stats_Flag);
   printf("User_Data_Flag                       = %d\n", User_Data_Flag);
+  printf("Readahead_Buffers                    = %d\n", Readahead_Buffers);
+  printf("Live_Drop_Flag                       = %d\n", Live_Drop_Flag);
+  printf("Output_Delay                         = %d\n", Output_Delay);
+  printf("Index_Filename                       = %s\n", Index_Filename ? Index_Filename : "");
+  printf("Start_GOP                            = %d\n", Start_GOP);
+  printf("Video_Stream                         = %d\n", Video_Stream);
+  printf("Program_Count                        = %d\n", Program_Count);
 
 }
 #endif
@@ -47,6 +47,21 @@
 
 #define VIDEO_ELEMENTARY_STREAM 0x1e0
 
+/* System_Stream_Flag */
+#define PROGRAM_STREAM   1
+#define TRANSPORT_STREAM 2
+
+/* ISO/IEC 13818-1 section 2.4.3 transport stream packets */
+#define TRANSPORT_SYNC_BYTE   0x47
+#define TRANSPORT_PACKET_SIZE 188
+#define PAT_PID               0x0000
+#define NULL_PID              0x1FFF
+#define MAX_PROGRAMS          32     /* decoded in parallel, multi.c */
+
+/* luminance samples around each side of the picture in the picture
+   buffers, which repeat its border samples (Extend_Edges(), getpic.c) */
+#define EDGE 32
+
 /* scalable_mode */
 #define SC_NONE 0
 #define SC_DP   1
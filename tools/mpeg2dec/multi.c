@@ -0,0 +1,403 @@
+/* multi.c, decoding several programs of a transport stream              */
+
+
+/* Copyright (C) 1996, MPEG Software Simulation Group. All Rights Reserved. */
+
+/*
+ * Disclaimer of Warranty
+ *
+ * These software programs are available to the user without any license fee or
+ * royalty on an "as is" basis.  The MPEG Software Simulation Group disclaims
+ * any and all warranties, whether express, implied, or statuary, including any
+ * implied warranties or merchantability or of fitness for a particular
+ * purpose.  In no event shall the copyright-holder be liable for any
+ * incidental, punitive, or consequential damages of any kind whatsoever
+ * arising from the use of these programs.
+ *
+ * This disclaimer of warranty extends to the user of these programs and user's
+ * customers, employees, agents, transferees, successors, and assigns.
+ *
+ * The MPEG Software Simulation Group does not represent or warrant that the
+ * programs furnished hereunder are free of infringement of any third-party
+ * patents.
+ *
+ * Commercial implementations of MPEG-1 and MPEG-2 video, including shareware,
+ * are subject to royalty fees to patent holders.  Many of these patents are
+ * general enough such that they are unavoidable regardless of implementation
+ * design.
+ *
+ */
+
+
+/* With -p and several video PIDs (or -pall: every MPEG-1/2 video stream
+ * of every program in the PAT), the main thread demultiplexes the
+ * transport stream once: it copies the transport packets of each video
+ * PID into the read-ahead ring (readahead.c) of a decoding thread of its
+ * own, which runs the usual decoder on them as a transport stream that
+ * holds nothing but that PID. All decoder state is thread local (see
+ * EXTERN in global.h), so each thread has its own reference frames,
+ * demultiplexer counters and output files, named like those of -o with
+ * the PID in front of the file name: -o0 rec%d writes 256_rec0.Y etc.
+ *
+ * Packets are handed over one ring buffer at a time, and whatever has
+ * been collected whenever the input runs dry. A thread that is behind
+ * holds up the others once its ring is full. The byte offsets that a
+ * decoding thread reports are those of its own packets.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "global.h"
+
+#ifdef HAVE_PTHREAD
+
+#include <pthread.h>
+
+struct program {
+  int Pid;
+  int Join;                  /* packets were missed: start at a sequence header */
+  int Failed;                /* ended by Error() */
+  int Ended;                 /* the thread reads no more */
+  char Output[FILENAME_LENGTH];
+  struct readahead *Ring;
+  unsigned char *Buffer;     /* ring slot being filled, or NULL */
+  int Length, Size;
+  pthread_t Thread;
+};
+
+static struct program Program[MAX_PROGRAMS];
+static int Programs;
+static int Pmt_Pids[MAX_PROGRAMS], Pmts;
+static unsigned char Seen[(NULL_PID+1)/8];  /* PIDs of packets so far */
+
+/* the program of the current decoding thread, NULL in the main thread */
+static THREAD_LOCAL struct program *Current_Program;
+
+/* private prototypes */
+static void Add_Program _ANSI_ARGS_((int pid));
+static void *Decode_Program _ANSI_ARGS_((void *arg));
+static void Put_Packet _ANSI_ARGS_((struct program *p, unsigned char *pkt));
+static void Flush_Program _ANSI_ARGS_((struct program *p));
+static int Read_Packet _ANSI_ARGS_((unsigned char *pkt));
+static void Parse_PAT _ANSI_ARGS_((unsigned char *pkt));
+static void Parse_PMT _ANSI_ARGS_((unsigned char *pkt));
+
+/* start the decoding thread of video PID pid */
+static void Add_Program(pid)
+int pid;
+{
+  struct program *p;
+  char *name;
+  int i;
+
+  for (i=0; i<Programs; i++)
+    if (Program[i].Pid==pid)
+      return;
+
+  if (Programs==MAX_PROGRAMS)
+  {
+    if (!Quiet_Flag)
+      fprintf(stderr,"more than %d video PIDs, PID %d not decoded\n",MAX_PROGRAMS,pid);
+    return;
+  }
+
+  p = &Program[Programs++];
+  p->Pid = pid;
+  p->Join = (Seen[pid>>3]>>(pid&7)) & 1;
+
+  /* output file names: the PID in front of the last path component */
+  if ((name = strrchr(Output_Picture_Filename,'/'))!=NULL)
+    name++;
+  else
+    name = Output_Picture_Filename;
+  snprintf(p->Output,sizeof(p->Output),"%.*s%d_%s",
+    (int)(name-Output_Picture_Filename),Output_Picture_Filename,pid,name);
+
+  p->Ring = Open_Ring(Readahead_Buffers);
+
+  if (Verbose_Flag>NO_LAYER)
+    printf("transport stream video PID %d: decoding thread %d\n",pid,Programs);
+
+  if (pthread_create(&p->Thread,NULL,Decode_Program,p))
+    Error("unable to start decoding thread\n");
+}
+
+/* decoding thread: the usual decoder, on the packets of one PID */
+static void *Decode_Program(arg)
+void *arg;
+{
+  struct program *p;
+  int i;
+
+  p = (struct program *)arg;
+  Current_Program = p;
+
+  System_Stream_Flag = TRANSPORT_STREAM;
+  Video_Stream = p->Pid;
+  Output_Picture_Filename = p->Output;
+
+  for (i=0; i<12; i++)
+  {
+    if (!(base.block[i] = (short *)valloc(64*sizeof(short))))
+      Error("out of memory\n");
+    memset(base.block[i],0,64*sizeof(short));
+  }
+
+  ld = &base;
+  base.Infile = -1;
+  base.Ring = p->Ring;
+  base.Stream_Id = base.Pid = Video_Stream;
+  base.Pmt_Pid = -1;
+
+  Initialize_Buffer();
+  if (p->Join)
+    Join_Sequence();
+
+  Initialize_Decoder();
+  Decode_Bitstream();
+
+  if (!Quiet_Flag)
+  {
+    flockfile(stdout);
+    printf("video PID %d:\n",p->Pid);
+    Print_Demux_Statistics();
+    Print_Output_Timing();
+    funlockfile(stdout);
+  }
+
+  Stop_Readahead();
+  return NULL;
+}
+
+/* Error() in a decoding thread ends that thread only */
+void End_Program()
+{
+  if (Current_Program==NULL)
+    return;
+
+  Current_Program->Failed = 1;
+  ld = &base;
+  Stop_Readahead();
+  pthread_exit(NULL);
+}
+
+/* copy a transport packet into the ring of program p */
+static void Put_Packet(p,pkt)
+struct program *p;
+unsigned char *pkt;
+{
+  if (p->Ended)
+    return;
+
+  if (p->Buffer==NULL)
+  {
+    if ((p->Buffer = Ring_Buffer(p->Ring,&p->Size))==NULL)
+    {
+      p->Ended = 1;
+      return;
+    }
+    p->Length = 0;
+  }
+
+  memcpy(p->Buffer+p->Length,pkt,TRANSPORT_PACKET_SIZE);
+  p->Length += TRANSPORT_PACKET_SIZE;
+
+  if (p->Length + TRANSPORT_PACKET_SIZE > p->Size)
+    Flush_Program(p);
+}
+
+/* hand the packets collected for program p over to its thread */
+static void Flush_Program(p)
+struct program *p;
+{
+  if (p->Buffer!=NULL && p->Length>0)
+  {
+    Put_Ring_Buffer(p->Ring,p->Length);
+    p->Buffer = NULL;
+  }
+}
+
+/* next transport packet of the input, 0 at end of file */
+static int Read_Packet(pkt)
+unsigned char *pkt;
+{
+  int i, Sync_Lost;
+
+  Sync_Lost = 0;
+
+  for (;;)
+  {
+    /* hand over what there is before waiting for more input */
+    if (ld->Rdptr >= ld->Rdend)
+      for (i=0; i<Programs; i++)
+        Flush_Program(&Program[i]);
+
+    pkt[0] = Get_Byte();
+    if (Bitstream_Padding())
+      return 0;
+
+    if (pkt[0]==TRANSPORT_SYNC_BYTE)
+      break;
+
+    if (!Sync_Lost)
+    {
+      ld->Demux.Sync_Errors++;
+      if (!Quiet_Flag)
+        fprintf(stderr,"transport stream sync lost at byte %ld\n",
+          Bitstream_Offset(ld->Rdptr)-1);
+    }
+    Sync_Lost = 1;
+  }
+
+  if (ld->Rdend - ld->Rdptr >= TRANSPORT_PACKET_SIZE-1)
+  {
+    memcpy(pkt+1,ld->Rdptr,TRANSPORT_PACKET_SIZE-1);
+    ld->Rdptr += TRANSPORT_PACKET_SIZE-1;
+  }
+  else
+  {
+    for (i=1; i<TRANSPORT_PACKET_SIZE; i++)
+      pkt[i] = Get_Byte();
+    if (Bitstream_Padding())
+      return 0;
+  }
+
+  return 1;
+}
+
+/* program_association_section(): the PMT PIDs of all programs (-pall);
+   like systems.c, sections are expected to fit into one packet */
+static void Parse_PAT(pkt)
+unsigned char *pkt;
+{
+  unsigned char *p, *end;
+  int i, pid;
+
+  p = pkt + 4;
+  if (pkt[3] & 0x20)
+    p += 1 + p[0];                          /* adaptation_field() */
+  p += 1 + p[0];                            /* pointer_field */
+  end = pkt + TRANSPORT_PACKET_SIZE;
+  if (p + 8 > end || p[0]!=0x00)            /* table_id */
+    return;
+
+  end = p + 3 + (((p[1]<<8) | p[2]) & 0x0fff) - 4;  /* up to CRC_32 */
+  if (end > pkt + TRANSPORT_PACKET_SIZE)
+    end = pkt + TRANSPORT_PACKET_SIZE;
+
+  for (p+=8; p+4<=end; p+=4)
+  {
+    /* program_number 0 is the network PID */
+    if (((p[0]<<8) | p[1])==0)
+      continue;
+    pid = ((p[2]<<8) | p[3]) & 0x1fff;
+    for (i=0; i<Pmts && Pmt_Pids[i]!=pid; i++)
+      ;
+    if (i==Pmts && Pmts<MAX_PROGRAMS)
+      Pmt_Pids[Pmts++] = pid;
+  }
+}
+
+/* TS_program_map_section(): the MPEG-1 and MPEG-2 video streams */
+static void Parse_PMT(pkt)
+unsigned char *pkt;
+{
+  unsigned char *p, *end;
+
+  p = pkt + 4;
+  if (pkt[3] & 0x20)
+    p += 1 + p[0];
+  p += 1 + p[0];
+  end = pkt + TRANSPORT_PACKET_SIZE;
+  if (p + 12 > end || p[0]!=0x02)           /* table_id */
+    return;
+
+  end = p + 3 + (((p[1]<<8) | p[2]) & 0x0fff) - 4;
+  if (end > pkt + TRANSPORT_PACKET_SIZE)
+    end = pkt + TRANSPORT_PACKET_SIZE;
+
+  p += 12 + (((p[10]<<8) | p[11]) & 0x0fff);  /* program_info_length */
+
+  for (; p+5<=end; p += 5 + (((p[3]<<8) | p[4]) & 0x0fff))
+  {
+    /* stream_type 0x01: ISO/IEC 11172-2, 0x02: ISO/IEC 13818-2 video */
+    if (p[0]==0x01 || p[0]==0x02)
+      Add_Program(((p[1]<<8) | p[2]) & 0x1fff);
+  }
+}
+
+/* decode the programs of -p in parallel, see above; returns the exit
+ * status of main()
+ */
+int Decode_Programs()
+{
+  unsigned char pkt[TRANSPORT_PACKET_SIZE];
+  int i, pid, ret;
+
+  if (System_Stream_Flag!=TRANSPORT_STREAM)
+    Error("several programs (-p) need a transport stream\n");
+  if (Two_Streams || Start_GOP>=0 || Index_Filename!=NULL || Ersatz_Flag
+      || Spatial_Flag || Output_Type==T_X11 || Output_Type==T_X11HIQ)
+    Error("-e, -k, -l, -s, -x and display are not supported with several programs\n");
+
+  Reset_Buffer();
+
+  for (i=0; i<Program_Count; i++)
+    Add_Program(Program_Pids[i]);
+
+  while (Read_Packet(pkt))
+  {
+    pid = ((pkt[1]<<8) | pkt[2]) & 0x1fff;
+
+    if (Program_Count<0 && (pkt[1] & 0x40))
+    {
+      if (pid==PAT_PID)
+        Parse_PAT(pkt);
+      else
+        for (i=0; i<Pmts; i++)
+          if (pid==Pmt_Pids[i])
+            Parse_PMT(pkt);
+    }
+
+    for (i=0; i<Programs; i++)
+      if (Program[i].Pid==pid)
+      {
+        Put_Packet(&Program[i],pkt);
+        break;
+      }
+
+    Seen[pid>>3] |= 1<<(pid&7);
+  }
+
+  /* end of file */
+  ret = 0;
+  for (i=0; i<Programs; i++)
+  {
+    Flush_Program(&Program[i]);
+    if (!Program[i].Ended && Ring_Buffer(Program[i].Ring,&Program[i].Size)!=NULL)
+      Put_Ring_Buffer(Program[i].Ring,0);
+  }
+
+  for (i=0; i<Programs; i++)
+  {
+    pthread_join(Program[i].Thread,NULL);
+    Free_Ring(Program[i].Ring);
+    if (Program[i].Failed)
+      ret = 1;
+  }
+
+  if (!Quiet_Flag)
+  {
+    if (Programs==0)
+      fprintf(stderr,"no video PID found\n");
+    if (ld->Demux.Sync_Errors)
+      printf("transport stream: %ld sync errors\n",ld->Demux.Sync_Errors);
+  }
+
+  return ret;
+}
+
+#endif /* HAVE_PTHREAD */
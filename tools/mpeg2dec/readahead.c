@@ -0,0 +1,494 @@
+/* readahead.c, background read-ahead of the input bitstream                 */
+
+/* Copyright (C) 1996, MPEG Software Simulation Group. All Rights Reserved. */
+
+/*
+ * Disclaimer of Warranty
+ *
+ * These software programs are available to the user without any license fee or
+ * royalty on an "as is" basis.  The MPEG Software Simulation Group disclaims
+ * any and all warranties, whether express, implied, or statuary, including any
+ * implied warranties or merchantability or of fitness for a particular
+ * purpose.  In no event shall the copyright-holder be liable for any
+ * incidental, punitive, or consequential damages of any kind whatsoever
+ * arising from the use of these programs.
+ *
+ * This disclaimer of warranty extends to the user of these programs and user's
+ * customers, employees, agents, transferees, successors, and assigns.
+ *
+ * The MPEG Software Simulation Group does not represent or warrant that the
+ * programs furnished hereunder are free of infringement of any third-party
+ * patents.
+ *
+ * Commercial implementations of MPEG-1 and MPEG-2 video, including shareware,
+ * are subject to royalty fees to patent holders.  Many of these patents are
+ * general enough such that they are unavoidable regardless of implementation
+ * design.
+ *
+ */
+
+
+/* A reader thread fills a ring of large buffers from ld->Infile while the
+ * decoder consumes them through Fill_Buffer() and Get_Byte(). The ring is
+ * a single producer / single consumer queue: the reader only advances
+ * Head, the decoder only advances Tail, and each slot is handed over by a
+ * release store of the index that covers it. Neither side ever takes a
+ * lock; a side that finds the ring full (reader) or empty (decoder)
+ * yields and polls again. The ring depth is the backpressure: the reader
+ * never gets more than Count buffers ahead of the decoder, including the
+ * one the decoder is working on.
+ *
+ * Live input (stdin and sockets, see live.c) always goes through the ring,
+ * in smaller buffers that are handed over as soon as read() would block,
+ * so that the decoder is not kept waiting for a full buffer. Once the decoder falls
+ * Count buffers behind, the reader either stops reading (the default: the
+ * sender is held up by the pipe or TCP window; UDP datagrams are lost in
+ * the kernel) or, with -d, keeps reading and throws the data away, then
+ * resumes at the next start code prefix, or transport packet, once a
+ * slot is free again.
+ *
+ * The demultiplexer of multi.c feeds the rings of the decoding threads
+ * the same way, through Ring_Buffer() and Put_Ring_Buffer() instead of a
+ * reader thread.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "global.h"
+
+#ifdef HAVE_PTHREAD
+
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <poll.h>
+
+#define READAHEAD_BUFFER_SIZE (1<<20)
+#define LIVE_BUFFER_SIZE      (1<<17)
+#define MAX_DATAGRAM_SIZE     (1<<16)
+#define LIVE_BUFFERS          16
+
+struct readahead {
+  int Infile;
+  int Reader;                /* filled by Readahead_Thread() */
+  int Closed;                /* the decoder has stopped reading */
+  int Live;                  /* hand over every read(), see above */
+  int Drop;                  /* live input: drop data when the ring is full */
+  int Transport;             /* live input is a transport stream */
+  int Size;                  /* bytes per slot */
+  int Count;                 /* number of ring slots */
+  unsigned char **Data;
+  int *Length;               /* bytes in slot, 0 marks end of file */
+  unsigned int Head;         /* slots filled, advanced by the reader */
+  unsigned int Tail;         /* slots released, advanced by the decoder */
+  int Holding;               /* decoder is working on slot Tail */
+  int Eof;                   /* end of file reached, padding */
+  long Total;                /* bytes handed to the decoder */
+  unsigned char *Scratch;    /* reader: data dropped while the ring is full */
+  int Dropping;              /* reader: looking for a start code */
+  long Dropped;              /* reader: bytes thrown away */
+  int Overflows;             /* reader: times the ring ran full */
+  pthread_t Thread;
+};
+
+/* private prototypes */
+static void *Readahead_Thread _ANSI_ARGS_((void *arg));
+static void Readahead_Wait _ANSI_ARGS_((int *spins));
+static int Readahead_Read _ANSI_ARGS_((struct readahead *ra, unsigned char *p,
+  int size));
+static int Resync _ANSI_ARGS_((struct readahead *ra, unsigned char *p, int len));
+static int Readahead_More _ANSI_ARGS_((struct readahead *ra, int len));
+static struct readahead *New_Ring _ANSI_ARGS_((int buffers, int size));
+
+/* back off while the other side catches up */
+static void Readahead_Wait(spins)
+int *spins;
+{
+  struct timespec ts;
+
+  if (++*spins < 64)
+    sched_yield();
+  else
+  {
+    ts.tv_sec = 0;
+    ts.tv_nsec = 100000;
+    nanosleep(&ts,NULL);
+  }
+}
+
+/* read() that retries on EINTR and skips empty datagrams; 0 at the end
+ * of the input or on an error
+ */
+static int Readahead_Read(ra,p,size)
+struct readahead *ra;
+unsigned char *p;
+int size;
+{
+  int n;
+
+  do
+    n = read(ra->Infile,p,size);
+  while ((n<0 && errno==EINTR) || (n==0 && ra->Live==2));
+
+  return n<0 ? 0 : n;
+}
+
+/* can live input go on filling a slot that holds len bytes: more data is
+ * there right away and, for datagrams, a whole one fits
+ */
+static int Readahead_More(ra,len)
+struct readahead *ra;
+int len;
+{
+  struct pollfd pfd;
+
+  if (ra->Live==2 && ra->Size-len < MAX_DATAGRAM_SIZE)
+    return 0;
+
+  pfd.fd = ra->Infile;
+  pfd.events = POLLIN;
+  return poll(&pfd,1,0)==1;
+}
+
+/* after an overflow: discard the len bytes at p up to the next start code
+ * prefix, keeping up to two trailing zero bytes that may begin one; for
+ * transport streams up to the next sync byte that two more follow a packet
+ * apart, keeping the bytes too close to the end to tell;
+ * returns the number of bytes left at p
+ */
+static int Resync(ra,p,len)
+struct readahead *ra;
+unsigned char *p;
+int len;
+{
+  int i, keep;
+
+  if (__atomic_load_n(&ra->Transport,__ATOMIC_ACQUIRE))
+  {
+    for (i=0; i+2*TRANSPORT_PACKET_SIZE<len; i++)
+      if (p[i]==TRANSPORT_SYNC_BYTE
+          && p[i+TRANSPORT_PACKET_SIZE]==TRANSPORT_SYNC_BYTE
+          && p[i+2*TRANSPORT_PACKET_SIZE]==TRANSPORT_SYNC_BYTE)
+        break;
+
+    if (i+2*TRANSPORT_PACKET_SIZE<len)
+    {
+      ra->Dropping = 0;
+      keep = len - i;
+    }
+    else
+      keep = (len < 2*TRANSPORT_PACKET_SIZE) ? len : 2*TRANSPORT_PACKET_SIZE;
+  }
+  else
+  {
+    for (i=0; i+2<len; i++)
+      if (p[i]==0 && p[i+1]==0 && p[i+2]==1)
+        break;
+
+    if (i+2<len)
+    {
+      ra->Dropping = 0;
+      keep = len - i;
+    }
+    else
+    {
+      for (keep=0; keep<2 && keep<len && p[len-1-keep]==0; keep++)
+        ;
+    }
+  }
+
+  ra->Dropped += len - keep;
+  memmove(p,p+len-keep,keep);
+  return keep;
+}
+
+static void *Readahead_Thread(arg)
+void *arg;
+{
+  struct readahead *ra;
+  unsigned int head;
+  unsigned char *p;
+  int len, n, spins, eof;
+
+  ra = (struct readahead *)arg;
+  head = 0;
+  eof = 0;
+
+  for (;;)
+  {
+    /* wait for a free slot, or drop what comes in meanwhile */
+    spins = 0;
+    while (head - __atomic_load_n(&ra->Tail,__ATOMIC_ACQUIRE)
+           >= (unsigned int)ra->Count)
+    {
+      if (!ra->Drop || eof)
+        Readahead_Wait(&spins);
+      else
+      {
+        if ((n = Readahead_Read(ra,ra->Scratch,ra->Size))==0)
+          eof = 1;
+        if (!ra->Dropping)
+          ra->Overflows++;
+        ra->Dropping = 1;
+        ra->Dropped += n;
+      }
+    }
+
+    /* fill it completely unless the file ends (pipes return short reads);
+       live input is handed over as it comes */
+    p = ra->Data[head % ra->Count];
+    len = 0;
+    while (!eof && len < ra->Size
+           && (len==0 || ra->Dropping || !ra->Live || Readahead_More(ra,len)))
+    {
+      if ((n = Readahead_Read(ra,p+len,ra->Size-len))==0)
+        eof = 1;
+      len += n;
+      if (ra->Dropping)
+        len = Resync(ra,p,len);
+    }
+
+    /* an empty slot marks the end of file */
+    ra->Length[head % ra->Count] = ra->Dropping ? 0 : len;
+    __atomic_store_n(&ra->Head,++head,__ATOMIC_RELEASE);
+
+    if (len==0 || (eof && ra->Dropping))
+      return NULL; /* end of file (or read error) */
+  }
+}
+
+/* a ring of Buffers slots of Size bytes */
+static struct readahead *New_Ring(Buffers,Size)
+int Buffers, Size;
+{
+  struct readahead *ra;
+  int i;
+
+  if (Buffers < 2)
+    Buffers = 2;
+
+  if (!(ra = (struct readahead *)calloc(1,sizeof(struct readahead))))
+    Error("readahead malloc failed\n");
+
+  ra->Count = Buffers;
+  ra->Size = Size;
+
+  if (!(ra->Data = (unsigned char **)malloc(Buffers*sizeof(unsigned char *)))
+      || !(ra->Length = (int *)malloc(Buffers*sizeof(int))))
+    Error("readahead malloc failed\n");
+
+  for (i=0; i<Buffers; i++)
+    if (!(ra->Data[i] = (unsigned char *)malloc(Size)))
+      Error("readahead buffer malloc failed\n");
+
+  return ra;
+}
+
+/* start reading the current layer's input file on a separate thread;
+ * Buffers of 0 picks the default depth of live input
+ */
+void Start_Readahead(Buffers)
+int Buffers;
+{
+  struct readahead *ra;
+
+  if (Buffers==0)
+    Buffers = LIVE_BUFFERS;
+
+  ra = New_Ring(Buffers,ld->Live ? LIVE_BUFFER_SIZE : READAHEAD_BUFFER_SIZE);
+  ra->Infile = ld->Infile;
+  ra->Reader = 1;
+  ra->Live = ld->Live;
+  ra->Drop = ld->Live && Live_Drop_Flag;
+
+  /* Initialize_Buffer() cannot ask the file once the thread runs */
+  if (ld->Live || (ld->Filepos = lseek(ld->Infile,0L,SEEK_CUR)) < 0)
+    ld->Filepos = 0;
+
+  if (ra->Drop && !(ra->Scratch = (unsigned char *)malloc(ra->Size)))
+    Error("readahead buffer malloc failed\n");
+
+  if (pthread_create(&ra->Thread,NULL,Readahead_Thread,ra))
+    Error("unable to start readahead thread\n");
+
+  ld->Ring = ra;
+}
+
+/* the live input of the current layer is a transport stream: let its
+ * reader resume at a packet after dropping data (Probe_Live_Input())
+ */
+void Transport_Readahead()
+{
+  __atomic_store_n(&ld->Ring->Transport,1,__ATOMIC_RELEASE);
+}
+
+/* stop the reader thread of the current layer and free the ring; a ring
+ * that another thread fills is only marked closed, its owner frees it
+ */
+void Stop_Readahead()
+{
+  struct readahead *ra;
+
+  if ((ra = ld->Ring)==NULL)
+    return;
+  ld->Ring = NULL;
+
+  if (!ra->Reader)
+  {
+    __atomic_store_n(&ra->Closed,1,__ATOMIC_RELEASE);
+    return;
+  }
+
+  pthread_cancel(ra->Thread);
+  pthread_join(ra->Thread,NULL);
+
+  if (ra->Overflows && !Quiet_Flag)
+    fprintf(stderr,"live input: %d overflows, %ld bytes dropped\n",
+      ra->Overflows,ra->Dropped);
+
+  Free_Ring(ra);
+}
+
+/* a ring for the decoding thread of a program, see multi.c */
+struct readahead *Open_Ring(Buffers)
+int Buffers;
+{
+  return New_Ring(Buffers ? Buffers : LIVE_BUFFERS,LIVE_BUFFER_SIZE);
+}
+
+void Free_Ring(ra)
+struct readahead *ra;
+{
+  int i;
+
+  for (i=0; i<ra->Count; i++)
+    free(ra->Data[i]);
+  free(ra->Data);
+  free(ra->Length);
+  free(ra->Scratch);
+  free(ra);
+}
+
+/* wait for a free slot of a ring without reader thread and return it,
+ * its size in *Size; NULL once the decoder has stopped reading
+ */
+unsigned char *Ring_Buffer(ra,Size)
+struct readahead *ra;
+int *Size;
+{
+  int spins;
+
+  spins = 0;
+  while (ra->Head - __atomic_load_n(&ra->Tail,__ATOMIC_ACQUIRE)
+         >= (unsigned int)ra->Count)
+  {
+    if (__atomic_load_n(&ra->Closed,__ATOMIC_ACQUIRE))
+      return NULL;
+    Readahead_Wait(&spins);
+  }
+
+  *Size = ra->Size;
+  return ra->Data[ra->Head % ra->Count];
+}
+
+/* hand the slot of Ring_Buffer() over to the decoder with Length bytes,
+ * 0 for end of file
+ */
+void Put_Ring_Buffer(ra,Length)
+struct readahead *ra;
+int Length;
+{
+  ra->Length[ra->Head % ra->Count] = Length;
+  __atomic_store_n(&ra->Head,ra->Head+1,__ATOMIC_RELEASE);
+}
+
+/* copy up to Size bytes from the front of the ring to Buffer without
+ * consuming them, waiting until that many are there, the input ends or
+ * the ring is full (live input may come in reads too small to fill
+ * Size before that); lets main() probe the stream type of input that
+ * cannot be rewound. Returns the number of bytes copied.
+ */
+int Peek_Readahead(Buffer,Size)
+unsigned char *Buffer;
+int Size;
+{
+  struct readahead *ra;
+  unsigned int slot;
+  int n, len, spins;
+
+  ra = ld->Ring;
+  slot = ra->Tail + ra->Holding;
+  n = 0;
+  spins = 0;
+
+  while (n < Size)
+  {
+    if (__atomic_load_n(&ra->Head,__ATOMIC_ACQUIRE)==slot)
+    {
+      /* nothing more comes in until the decoder takes a slot */
+      if (slot - ra->Tail >= (unsigned int)ra->Count)
+        break;
+      Readahead_Wait(&spins);
+      continue;
+    }
+
+    if ((len = ra->Length[slot % ra->Count])==0)
+      break;
+    if (len > Size - n)
+      len = Size - n;
+    memcpy(Buffer+n,ra->Data[slot % ra->Count],len);
+    n += len;
+    slot++;
+  }
+
+  return n;
+}
+
+/* release the buffer the decoder has finished with and point Rdptr/Rdend
+ * at the next one; at end of file continue with sequence end codes,
+ * like Fill_Buffer() does for read() input
+ */
+void Next_Readahead_Buffer()
+{
+  struct readahead *ra;
+  int len, spins;
+
+  ra = ld->Ring;
+
+  if (ra->Eof)
+  {
+    Pad_Buffer(0);
+    return;
+  }
+
+  if (ra->Holding)
+  {
+    __atomic_store_n(&ra->Tail,ra->Tail+1,__ATOMIC_RELEASE);
+    ra->Holding = 0;
+  }
+
+  spins = 0;
+  while (__atomic_load_n(&ra->Head,__ATOMIC_ACQUIRE)==ra->Tail)
+    Readahead_Wait(&spins);
+
+  len = ra->Length[ra->Tail % ra->Count];
+
+  if (len==0)
+  {
+    Pad_Buffer((int)(-ra->Total&3));
+    ra->Eof = 1;
+    return;
+  }
+
+  ra->Holding = 1;
+  ra->Total += len;
+  ld->Rdptr = ra->Data[ra->Tail % ra->Count];
+  ld->Rdend = ld->Rdptr + len;
+}
+
+#endif /* HAVE_PTHREAD */
@@ -28,10 +28,15 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 
 #include "config.h"
 #include "global.h"
 
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
 #ifdef TRACE_RECON
 /* Detailed tracing */
 static int printPixelAddress(unsigned char *addr, char *str, unsigned char *frame_addr, int w, int h)
@@ -59,30 +64,78 @@ static int printPixelAddress(unsigned char *addr, char *str, unsigned char *fram
 void printPixel(unsigned char *addr)
 {
   if (
-  !printPixelAddress(addr, "bwd_y", backward_reference_frame[0], Coded_Picture_Width, Coded_Picture_Height) &&
-  !printPixelAddress(addr, "fwd_y", forward_reference_frame[0], Coded_Picture_Width, Coded_Picture_Height) &&
-  !printPixelAddress(addr, "aux_y", auxframe[0], Coded_Picture_Width, Coded_Picture_Height) &&
-  !printPixelAddress(addr, "bwd_u", backward_reference_frame[1], Chroma_Width, Chroma_Height) &&
-  !printPixelAddress(addr, "fwd_u", forward_reference_frame[1], Chroma_Width, Chroma_Height) &&
-  !printPixelAddress(addr, "aux_u", auxframe[1], Chroma_Width, Chroma_Height) &&
-  !printPixelAddress(addr, "bwd_v", backward_reference_frame[2], Chroma_Width, Chroma_Height) &&
-  !printPixelAddress(addr, "fwd_v", forward_reference_frame[2], Chroma_Width, Chroma_Height) &&
-  !printPixelAddress(addr, "aux_v", auxframe[2], Chroma_Width, Chroma_Height)) {
+  !printPixelAddress(addr, "bwd_y", backward_reference_frame[0], Coded_Picture_Stride, Coded_Picture_Height) &&
+  !printPixelAddress(addr, "fwd_y", forward_reference_frame[0], Coded_Picture_Stride, Coded_Picture_Height) &&
+  !printPixelAddress(addr, "aux_y", auxframe[0], Coded_Picture_Stride, Coded_Picture_Height) &&
+  !printPixelAddress(addr, "bwd_u", backward_reference_frame[1], Chroma_Stride, Chroma_Height) &&
+  !printPixelAddress(addr, "fwd_u", forward_reference_frame[1], Chroma_Stride, Chroma_Height) &&
+  !printPixelAddress(addr, "aux_u", auxframe[1], Chroma_Stride, Chroma_Height) &&
+  !printPixelAddress(addr, "bwd_v", backward_reference_frame[2], Chroma_Stride, Chroma_Height) &&
+  !printPixelAddress(addr, "fwd_v", forward_reference_frame[2], Chroma_Stride, Chroma_Height) &&
+  !printPixelAddress(addr, "aux_v", auxframe[2], Chroma_Stride, Chroma_Height)) {
     printf ("***pixel not found***");
   }
 }
 #endif
 
+/* the loops of form_component_prediction() */
+#define PREDICT_ARGS _ANSI_ARGS_((unsigned char *s, unsigned char *d, \
+  int lx, int lx2, int dlx2, int w, int h))
+
+typedef void (*prediction_kernel) PREDICT_ARGS;
+
 /* private prototypes */
 static void form_prediction _ANSI_ARGS_((unsigned char *src[], int sfield,
-  unsigned char *dst[], int dfield,
+  unsigned char *dst[], int dlx2[],
   int lx, int lx2, int w, int h, int x, int y, int dx, int dy,
   int average_flag));
 
 static void form_component_prediction _ANSI_ARGS_((unsigned char *src, unsigned char *dst,
-  int lx, int lx2, int w, int h, int x, int y, int dx, int dy, int average_flag));
-
-void form_predictions(bx,by,macroblock_type,motion_type,PMV,motion_vertical_field_select,dmvector,stwtype)
+  int lx, int lx2, int dlx2, int w, int h, int x, int y, int dx, int dy,
+  int average_flag, prediction_kernel pred[2][4]));
+
+static void picture_area _ANSI_ARGS_((unsigned char *dst[], int dfield,
+  int bx, int by));
+
+static void copy_skipped_macroblocks _ANSI_ARGS_((int bx, int by, int w));
+
+/* block sizes with prediction kernels of their own, PRED_ANY for others */
+#define PRED_ANY   0
+#define PRED_16x16 1
+#define PRED_16x8  2
+#define PRED_8x16  3
+#define PRED_8x8   4
+#define PRED_8x4   5
+#define PRED_SIZES 6
+
+/* implementations of the loops of form_component_prediction(), best
+ * last, all with the same results: pred[size][average_flag][yh*2+xh]
+ * forms the prediction of w by h samples (w a multiple of 8) at d, lines
+ * dlx2 apart, from those at s, lines lx2 apart; the ones for fixed sizes
+ * ignore w and h.
+ */
+struct prediction_kernels
+{
+  char *name;
+  int (*usable) _ANSI_ARGS_((void)); /* NULL: on any CPU */
+  prediction_kernel pred[PRED_SIZES][2][4];
+};
+
+static THREAD_LOCAL struct prediction_kernels *predict;
+
+/* the kernels form_prediction() uses for the luma [0] and chroma [1]
+   blocks of a prediction whose luma block is of any size, 16x16 or 16x8
+   (Select_Prediction_Kernels()) */
+static THREAD_LOCAL prediction_kernel (*sized_pred[3][2])[4];
+
+/* the prediction of the macroblock at (bx,by), formed at pred[cc] for
+ * each component: the macroblock in current_frame[cc], or a buffer of its
+ * size (which Add_Macroblock() stores with the prediction error), whose
+ * lines are in the order of the picture's and lx[cc] apart
+ */
+void form_predictions(pred,lx,bx,by,macroblock_type,motion_type,PMV,motion_vertical_field_select,dmvector,stwtype)
+unsigned char *pred[];
+int lx[];
 int bx, by;
 int macroblock_type;
 int motion_type;
@@ -93,6 +146,8 @@ int stwtype;
   unsigned char **predframe;
   int DMV[2][2];
   int stwtop, stwbot;
+  unsigned char *half[2][3];
+  int cc, h, dlx2[3];
 
 #ifdef TRACE
 
@@ -144,6 +199,29 @@ int stwtype;
   stwtop = stwtype%3; /* 0:temporal, 1:(spat+temp)/2, 2:spatial */
   stwbot = stwtype/3;
 
+  /* the field a field picture is predicted into; the backward vectors of
+     B field pictures need it too */
+  currentfield = (picture_structure==BOTTOM_FIELD);
+
+  /* where the predictions go in pred[]: the top and bottom field of a
+     frame picture (every other line), the upper and lower 16x8 half of
+     a field picture's macroblock */
+  for (cc=0; cc<3; cc++)
+  {
+    h = (cc==0 || chroma_format!=CHROMA420) ? 16 : 8;
+    half[0][cc] = pred[cc];
+    if (picture_structure==FRAME_PICTURE)
+    {
+      half[1][cc] = pred[cc] + lx[cc];
+      dlx2[cc] = lx[cc]<<1;
+    }
+    else
+    {
+      half[1][cc] = pred[cc] + lx[cc]*(h>>1);
+      dlx2[cc] = lx[cc];
+    }
+  }
+
   if ((macroblock_type & MACROBLOCK_MOTION_FORWARD) 
    || (picture_coding_type==P_TYPE))
   {
@@ -155,13 +233,13 @@ int stwtype;
         /* frame-based prediction (broken into top and bottom halves
              for spatial scalability prediction purposes) */
         if (stwtop<2)
-          form_prediction(forward_reference_frame,0,current_frame,0,
-            Coded_Picture_Width,Coded_Picture_Width<<1,16,8,bx,by,
+          form_prediction(forward_reference_frame,0,half[0],dlx2,
+            Coded_Picture_Stride,Coded_Picture_Stride<<1,16,8,bx,by,
             PMV[0][0][0],PMV[0][0][1],stwtop);
 
         if (stwbot<2)
-          form_prediction(forward_reference_frame,1,current_frame,1,
-            Coded_Picture_Width,Coded_Picture_Width<<1,16,8,bx,by,
+          form_prediction(forward_reference_frame,1,half[1],dlx2,
+            Coded_Picture_Stride,Coded_Picture_Stride<<1,16,8,bx,by,
             PMV[0][0][0],PMV[0][0][1],stwbot);
 
 #ifdef TRACE
@@ -185,13 +263,13 @@ int stwtype;
         /* top field prediction */
         if (stwtop<2)
           form_prediction(forward_reference_frame,motion_vertical_field_select[0][0],
-            current_frame,0,Coded_Picture_Width<<1,Coded_Picture_Width<<1,16,8,
+            half[0],dlx2,Coded_Picture_Stride<<1,Coded_Picture_Stride<<1,16,8,
             bx,by>>1,PMV[0][0][0],PMV[0][0][1]>>1,stwtop);
 
         /* bottom field prediction */
         if (stwbot<2)
           form_prediction(forward_reference_frame,motion_vertical_field_select[1][0],
-            current_frame,1,Coded_Picture_Width<<1,Coded_Picture_Width<<1,16,8,
+            half[1],dlx2,Coded_Picture_Stride<<1,Coded_Picture_Stride<<1,16,8,
             bx,by>>1,PMV[1][0][0],PMV[1][0][1]>>1,stwbot);
 
 #ifdef TRACE
@@ -218,26 +296,26 @@ int stwtype;
         if (stwtop<2)
         {
           /* predict top field from top field */
-          form_prediction(forward_reference_frame,0,current_frame,0,
-            Coded_Picture_Width<<1,Coded_Picture_Width<<1,16,8,bx,by>>1,
+          form_prediction(forward_reference_frame,0,half[0],dlx2,
+            Coded_Picture_Stride<<1,Coded_Picture_Stride<<1,16,8,bx,by>>1,
             PMV[0][0][0],PMV[0][0][1]>>1,0);
 
           /* predict and add to top field from bottom field */
-          form_prediction(forward_reference_frame,1,current_frame,0,
-            Coded_Picture_Width<<1,Coded_Picture_Width<<1,16,8,bx,by>>1,
+          form_prediction(forward_reference_frame,1,half[0],dlx2,
+            Coded_Picture_Stride<<1,Coded_Picture_Stride<<1,16,8,bx,by>>1,
             DMV[0][0],DMV[0][1],1);
         }
 
         if (stwbot<2)
         {
           /* predict bottom field from bottom field */
-          form_prediction(forward_reference_frame,1,current_frame,1,
-            Coded_Picture_Width<<1,Coded_Picture_Width<<1,16,8,bx,by>>1,
+          form_prediction(forward_reference_frame,1,half[1],dlx2,
+            Coded_Picture_Stride<<1,Coded_Picture_Stride<<1,16,8,bx,by>>1,
             PMV[0][0][0],PMV[0][0][1]>>1,0);
 
           /* predict and add to bottom field from top field */
-          form_prediction(forward_reference_frame,0,current_frame,1,
-            Coded_Picture_Width<<1,Coded_Picture_Width<<1,16,8,bx,by>>1,
+          form_prediction(forward_reference_frame,0,half[1],dlx2,
+            Coded_Picture_Stride<<1,Coded_Picture_Stride<<1,16,8,bx,by>>1,
             DMV[1][0],DMV[1][1],1);
         }
 
@@ -279,8 +357,6 @@ int stwtype;
     else /* TOP_FIELD or BOTTOM_FIELD */
     {
       /* field picture */
-      currentfield = (picture_structure==BOTTOM_FIELD);
-
       /* determine which frame to use for prediction */
       if ((picture_coding_type==P_TYPE) && Second_Field
          && (currentfield!=motion_vertical_field_select[0][0]))
@@ -293,8 +369,8 @@ int stwtype;
       {
         /* field-based prediction */
         if (stwtop<2)
-          form_prediction(predframe,motion_vertical_field_select[0][0],current_frame,0,
-            Coded_Picture_Width<<1,Coded_Picture_Width<<1,16,16,bx,by,
+          form_prediction(predframe,motion_vertical_field_select[0][0],half[0],dlx2,
+            Coded_Picture_Stride<<1,Coded_Picture_Stride<<1,16,16,bx,by,
             PMV[0][0][0],PMV[0][0][1],stwtop);
 
 #ifdef TRACE
@@ -311,8 +387,8 @@ int stwtype;
       {
         if (stwtop<2)
         {
-          form_prediction(predframe,motion_vertical_field_select[0][0],current_frame,0,
-            Coded_Picture_Width<<1,Coded_Picture_Width<<1,16,8,bx,by,
+          form_prediction(predframe,motion_vertical_field_select[0][0],half[0],dlx2,
+            Coded_Picture_Stride<<1,Coded_Picture_Stride<<1,16,8,bx,by,
             PMV[0][0][0],PMV[0][0][1],stwtop);
 
           /* determine which frame to use for lower half prediction */
@@ -322,8 +398,8 @@ int stwtype;
           else
             predframe = forward_reference_frame; /* previous frame */
 
-          form_prediction(predframe,motion_vertical_field_select[1][0],current_frame,0,
-            Coded_Picture_Width<<1,Coded_Picture_Width<<1,16,8,bx,by+8,
+          form_prediction(predframe,motion_vertical_field_select[1][0],half[1],dlx2,
+            Coded_Picture_Stride<<1,Coded_Picture_Stride<<1,16,8,bx,by+8,
             PMV[1][0][0],PMV[1][0][1],stwtop);
         }
 
@@ -353,13 +429,13 @@ int stwtype;
         Dual_Prime_Arithmetic(DMV,dmvector,PMV[0][0][0],PMV[0][0][1]);
 
         /* predict from field of same parity */
-        form_prediction(forward_reference_frame,currentfield,current_frame,0,
-          Coded_Picture_Width<<1,Coded_Picture_Width<<1,16,16,bx,by,
+        form_prediction(forward_reference_frame,currentfield,half[0],dlx2,
+          Coded_Picture_Stride<<1,Coded_Picture_Stride<<1,16,16,bx,by,
           PMV[0][0][0],PMV[0][0][1],0);
 
         /* predict from field of opposite parity */
-        form_prediction(predframe,!currentfield,current_frame,0,
-          Coded_Picture_Width<<1,Coded_Picture_Width<<1,16,16,bx,by,
+        form_prediction(predframe,!currentfield,half[0],dlx2,
+          Coded_Picture_Stride<<1,Coded_Picture_Stride<<1,16,16,bx,by,
           DMV[0][0],DMV[0][1],1);
 
 #ifdef TRACE
@@ -397,13 +473,13 @@ int stwtype;
       {
         /* frame-based prediction */
         if (stwtop<2)
-          form_prediction(backward_reference_frame,0,current_frame,0,
-            Coded_Picture_Width,Coded_Picture_Width<<1,16,8,bx,by,
+          form_prediction(backward_reference_frame,0,half[0],dlx2,
+            Coded_Picture_Stride,Coded_Picture_Stride<<1,16,8,bx,by,
             PMV[0][1][0],PMV[0][1][1],stwtop);
 
         if (stwbot<2)
-          form_prediction(backward_reference_frame,1,current_frame,1,
-            Coded_Picture_Width,Coded_Picture_Width<<1,16,8,bx,by,
+          form_prediction(backward_reference_frame,1,half[1],dlx2,
+            Coded_Picture_Stride,Coded_Picture_Stride<<1,16,8,bx,by,
             PMV[0][1][0],PMV[0][1][1],stwbot);
 
 #ifdef TRACE
@@ -429,13 +505,13 @@ int stwtype;
         /* top field prediction */
         if (stwtop<2)
           form_prediction(backward_reference_frame,motion_vertical_field_select[0][1],
-            current_frame,0,Coded_Picture_Width<<1,Coded_Picture_Width<<1,16,8,
+            half[0],dlx2,Coded_Picture_Stride<<1,Coded_Picture_Stride<<1,16,8,
             bx,by>>1,PMV[0][1][0],PMV[0][1][1]>>1,stwtop);
 
         /* bottom field prediction */
         if (stwbot<2)
           form_prediction(backward_reference_frame,motion_vertical_field_select[1][1],
-            current_frame,1,Coded_Picture_Width<<1,Coded_Picture_Width<<1,16,8,
+            half[1],dlx2,Coded_Picture_Stride<<1,Coded_Picture_Stride<<1,16,8,
             bx,by>>1,PMV[1][1][0],PMV[1][1][1]>>1,stwbot);
 
 #ifdef TRACE
@@ -464,7 +540,7 @@ int stwtype;
       {
         /* field-based prediction */
         form_prediction(backward_reference_frame,motion_vertical_field_select[0][1],
-          current_frame,0,Coded_Picture_Width<<1,Coded_Picture_Width<<1,16,16,
+          half[0],dlx2,Coded_Picture_Stride<<1,Coded_Picture_Stride<<1,16,16,
           bx,by,PMV[0][1][0],PMV[0][1][1],stwtop);
 
 #ifdef TRACE
@@ -481,11 +557,11 @@ int stwtype;
       else if (motion_type==MC_16X8)
       {
         form_prediction(backward_reference_frame,motion_vertical_field_select[0][1],
-          current_frame,0,Coded_Picture_Width<<1,Coded_Picture_Width<<1,16,8,
+          half[0],dlx2,Coded_Picture_Stride<<1,Coded_Picture_Stride<<1,16,8,
           bx,by,PMV[0][1][0],PMV[0][1][1],stwtop);
 
         form_prediction(backward_reference_frame,motion_vertical_field_select[1][1],
-          current_frame,0,Coded_Picture_Width<<1,Coded_Picture_Width<<1,16,8,
+          half[1],dlx2,Coded_Picture_Stride<<1,Coded_Picture_Stride<<1,16,8,
           bx,by+8,PMV[1][1][0],PMV[1][1][1],stwtop);
 
 #ifdef TRACE
@@ -535,20 +611,230 @@ int stwtype;
 #endif
 }
 
-static void form_prediction(src,sfield,dst,dfield,lx,lx2,w,h,x,y,dx,dy,average_flag)
+/* ISO/IEC 13818-2 section 7.6.6: predict a run of n skipped macroblocks,
+ * from MBA on, in P or B pictures without scalability. They all have the
+ * prediction of the first one (skipped_macroblock() in getpic.c): zero
+ * vectors from the field of the same parity or the frame in P pictures,
+ * the vectors and directions of the previous macroblock in B pictures.
+ * Each row of the run is predicted as one area of n*16 samples.
+ */
+void form_skipped_predictions(MBA,n,macroblock_type,PMV,motion_vertical_field_select)
+int MBA, n;
+int macroblock_type;
+int PMV[2][2][2], motion_vertical_field_select[2][2];
+{
+  int k, bx, by, w, average_flag;
+  unsigned char *dst[2][3];
+  int dlx2[3];
+
+  for (; n>0; MBA+=k, n-=k)
+  {
+    /* the part of the run in this row */
+    bx = MBA%mb_width;
+    by = MBA/mb_width;
+    k = mb_width - bx;
+    if (k>n)
+      k = n;
+
+    bx<<= 4;
+    by<<= 4;
+    w = k<<4;
+
+    if (picture_coding_type==P_TYPE)
+    {
+      copy_skipped_macroblocks(bx,by,w);
+      continue;
+    }
+
+    /* where the predictions go: the top and bottom field of a frame
+       picture, the field of a field picture */
+    picture_area(dst[0],0,bx,by);
+    if (picture_structure==FRAME_PICTURE)
+      picture_area(dst[1],1,bx,by);
+
+    dlx2[0] = Coded_Picture_Stride<<1;
+    dlx2[1] = dlx2[2] = Chroma_Stride<<1;
+
+    average_flag = 0;
+
+    if (macroblock_type & MACROBLOCK_MOTION_FORWARD)
+    {
+      if (picture_structure==FRAME_PICTURE)
+      {
+        form_prediction(forward_reference_frame,0,dst[0],dlx2,
+          Coded_Picture_Stride,Coded_Picture_Stride<<1,w,8,bx,by,
+          PMV[0][0][0],PMV[0][0][1],0);
+        form_prediction(forward_reference_frame,1,dst[1],dlx2,
+          Coded_Picture_Stride,Coded_Picture_Stride<<1,w,8,bx,by,
+          PMV[0][0][0],PMV[0][0][1],0);
+      }
+      else
+        form_prediction(forward_reference_frame,motion_vertical_field_select[0][0],
+          dst[0],dlx2,Coded_Picture_Stride<<1,Coded_Picture_Stride<<1,w,16,
+          bx,by,PMV[0][0][0],PMV[0][0][1],0);
+
+      average_flag = 1;
+    }
+
+    if (macroblock_type & MACROBLOCK_MOTION_BACKWARD)
+    {
+      if (picture_structure==FRAME_PICTURE)
+      {
+        form_prediction(backward_reference_frame,0,dst[0],dlx2,
+          Coded_Picture_Stride,Coded_Picture_Stride<<1,w,8,bx,by,
+          PMV[0][1][0],PMV[0][1][1],average_flag);
+        form_prediction(backward_reference_frame,1,dst[1],dlx2,
+          Coded_Picture_Stride,Coded_Picture_Stride<<1,w,8,bx,by,
+          PMV[0][1][0],PMV[0][1][1],average_flag);
+      }
+      else
+        form_prediction(backward_reference_frame,motion_vertical_field_select[0][1],
+          dst[0],dlx2,Coded_Picture_Stride<<1,Coded_Picture_Stride<<1,w,16,
+          bx,by,PMV[0][1][0],PMV[0][1][1],average_flag);
+    }
+  }
+}
+
+/* skipped macroblocks of a P picture, w samples wide from (bx,by) on:
+   copy of forward_reference_frame (the same field in field pictures) */
+static void copy_skipped_macroblocks(bx,by,w)
+int bx, by, w;
+{
+  int cc, j, lx, x, y, cw, h;
+  unsigned char *s, *d;
+
+  for (cc=0; cc<3; cc++)
+  {
+    lx = Coded_Picture_Stride;
+    x = bx;
+    y = by;
+    cw = w;
+    h = 16;
+
+    if (cc!=0)
+    {
+      lx = Chroma_Stride;
+
+      if (chroma_format!=CHROMA444)
+      {
+        x>>= 1;
+        cw>>= 1;
+      }
+
+      if (chroma_format==CHROMA420)
+      {
+        y>>= 1;
+        h = 8;
+      }
+    }
+
+    s = forward_reference_frame[cc];
+    d = current_frame[cc];
+
+    /* current_frame[] already points to the bottom field */
+    if (picture_structure!=FRAME_PICTURE)
+    {
+      if (picture_structure==BOTTOM_FIELD)
+        s+= lx;
+      lx<<= 1;
+    }
+
+    s+= lx*y + x;
+    d+= lx*y + x;
+
+    for (j=0; j<h; j++)
+    {
+      memcpy(d,s,cw);
+      s+= lx;
+      d+= lx;
+    }
+  }
+}
+
+/* the top left sample of the area at (bx,by) of current_frame[] in each
+   component: in field dfield of a frame picture, in the field of a field
+   picture (dfield 0) */
+static void picture_area(dst,dfield,bx,by)
+unsigned char *dst[];
+int dfield;
+int bx, by;
+{
+  int cc, lx, x, y;
+
+  for (cc=0; cc<3; cc++)
+  {
+    lx = Coded_Picture_Stride;
+    x = bx;
+    y = by;
+
+    if (cc!=0)
+    {
+      lx = Chroma_Stride;
+
+      if (chroma_format!=CHROMA444)
+        x>>= 1;
+
+      if (chroma_format==CHROMA420)
+        y>>= 1;
+    }
+
+    /* current_frame[] already points to the bottom field */
+    if (picture_structure!=FRAME_PICTURE)
+      lx<<= 1;
+
+    dst[cc] = current_frame[cc] + lx*(y+dfield) + x;
+  }
+}
+
+static void form_prediction(src,sfield,dst,dlx2,lx,lx2,w,h,x,y,dx,dy,average_flag)
 unsigned char *src[]; /* prediction source buffer */
 int sfield;           /* prediction source field number (0 or 1) */
-unsigned char *dst[]; /* prediction destination buffer */
-int dfield;           /* prediction destination field number (0 or 1)*/
+unsigned char *dst[]; /* top left sample of the prediction */
+int dlx2[];           /* its line strides */
 int lx,lx2;           /* line strides */
 int w,h;              /* prediction block/sub-block width, height */
 int x,y;              /* pixel co-ordinates of top-left sample in current MB */
 int dx,dy;            /* horizontal, vertical prediction address */
 int average_flag;     /* add prediction error to prediction ? */
 {
+  prediction_kernel (**pred)[4];
+  int rows, edge, span;
+
+  /* keep the prediction inside the edge around the reference picture
+     (Extend_Edges(), getpic.c): the vectors of valid streams do not point
+     outside the picture, those of broken ones are clipped. The lines of
+     the raster are lx apart, h lines lx2 apart span 2*h of them if lx2 is
+     twice lx (both fields, from two calls) */
+  rows = Coded_Picture_Height;
+  edge = EDGE;
+  span = (lx2==lx) ? h : h<<1;
+
+  if (lx!=Coded_Picture_Stride)
+  {
+    rows>>= 1;
+    edge>>= 1;
+  }
+
+  if (2*x+dx < -2*EDGE)
+    dx = -2*(EDGE+x);
+  else if (2*x+dx > 2*(Coded_Picture_Width+EDGE-w))
+    dx = 2*(Coded_Picture_Width+EDGE-w-x);
+
+  if (2*y+dy < -2*edge)
+    dy = -2*(edge+y);
+  else if (2*y+dy > 2*(rows+edge-span))
+    dy = 2*(rows+edge-span-y);
+
+  if (w==16 && h==16)
+    pred = sized_pred[1];
+  else if (w==16 && h==8)
+    pred = sized_pred[2];
+  else
+    pred = sized_pred[0];
+
   /* Y */
-  form_component_prediction(src[0]+(sfield?lx2>>1:0),dst[0]+(dfield?lx2>>1:0),
-    lx,lx2,w,h,x,y,dx,dy,average_flag);
+  form_component_prediction(src[0]+(sfield?lx2>>1:0),dst[0],
+    lx,lx2,dlx2[0],w,h,x,y,dx,dy,average_flag,pred[0]);
 
   if (chroma_format!=CHROMA444)
   {
@@ -561,12 +847,12 @@ int average_flag;     /* add prediction error to prediction ? */
   }
 
   /* Cb */
-  form_component_prediction(src[1]+(sfield?lx2>>1:0),dst[1]+(dfield?lx2>>1:0),
-    lx,lx2,w,h,x,y,dx,dy,average_flag);
+  form_component_prediction(src[1]+(sfield?lx2>>1:0),dst[1],
+    lx,lx2,dlx2[1],w,h,x,y,dx,dy,average_flag,pred[1]);
 
   /* Cr */
-  form_component_prediction(src[2]+(sfield?lx2>>1:0),dst[2]+(dfield?lx2>>1:0),
-    lx,lx2,w,h,x,y,dx,dy,average_flag);
+  form_component_prediction(src[2]+(sfield?lx2>>1:0),dst[2],
+    lx,lx2,dlx2[2],w,h,x,y,dx,dy,average_flag,pred[1]);
 }
 
 /* ISO/IEC 13818-2 section 7.6.4: Forming predictions */
@@ -593,11 +879,12 @@ int average_flag;     /* add prediction error to prediction ? */
  *  was chosen for its elegance.
 */
 
-static void form_component_prediction(src,dst,lx,lx2,w,h,x,y,dx,dy,average_flag)
+static void form_component_prediction(src,dst,lx,lx2,dlx2,w,h,x,y,dx,dy,average_flag,pred)
 unsigned char *src;
 unsigned char *dst;
 int lx;          /* raster line increment */ 
 int lx2;
+int dlx2;        /* destination line increment */
 int w,h;
 int x,y;
 int dx,dy;
@@ -605,12 +892,12 @@ int average_flag;      /* flag that signals bi-directional or Dual-Prime
                           averaging (7.6.7.1 and 7.6.7.4). if average_flag==1,
                           a previously formed prediction has been stored in 
                           pel_pred[] */
+prediction_kernel pred[2][4]; /* the kernels for the block size */
 {
   int xint;      /* horizontal integer sample vector: analogous to int_vec[0] */
   int yint;      /* vertical integer sample vectors: analogous to int_vec[1] */
   int xh;        /* horizontal half sample flag: analogous to half_flag[0]  */
   int yh;        /* vertical half sample flag: analogous to half_flag[1]  */
-  int i, j, v;
   unsigned char *s;    /* source pointer: analogous to pel_ref[][]   */
   unsigned char *d;    /* destination pointer:  analogous to pel_pred[][]  */
 
@@ -622,18 +909,30 @@ int average_flag;      /* flag that signals bi-directional or Dual-Prime
   xh = dx & 1;
   yh = dy & 1;
 
-  /* compute the linear address of pel_ref[][] and pel_pred[][] 
-     based on cartesian/raster cordinates provided */
+  /* compute the linear address of pel_ref[][] based on
+     cartesian/raster cordinates provided; pel_pred[][] starts at dst */
   s = src + lx*(y+yint) + x + xint;
-  d = dst + lx*y + x;
+  d = dst;
 
 #ifdef TRACE_RECON
   if (Trace_Flag)
   {
-    printf("form_component_prediction: xint: %i xh: %i yint: %i yh: %i x: %i y: %i s: src+%i d: dst+%i\n", xint, xh, yint, yh, x, y, lx*(y+yint) + x + xint, lx*y + x);
+    printf("form_component_prediction: xint: %i xh: %i yint: %i yh: %i x: %i y: %i s: src+%i\n", xint, xh, yint, yh, x, y, lx*(y+yint) + x + xint);
   }
 #endif /* TRACE_RECON */
 
+  pred[average_flag][(yh<<1)|xh](s,d,lx,lx2,dlx2,w,h);
+}
+
+/* form_component_prediction() of w by h samples, inlined with constant
+   xh, yh and average_flag */
+ALWAYS_INLINE void predict_c(s,d,lx,lx2,dlx2,w,h,xh,yh,average_flag)
+unsigned char *s, *d;
+int lx, lx2, dlx2, w, h;
+int xh, yh, average_flag;
+{
+  int i, j, v;
+
   if (!xh && !yh) /* no horizontal nor vertical half-pel */
   {
     if (average_flag)
@@ -664,7 +963,7 @@ int average_flag;      /* flag that signals bi-directional or Dual-Prime
         }
       
         s+= lx2;
-        d+= lx2;
+        d+= dlx2;
       }
     }
     else
@@ -692,7 +991,7 @@ int average_flag;      /* flag that signals bi-directional or Dual-Prime
         }
         
         s+= lx2;
-        d+= lx2;
+        d+= dlx2;
       }
     }
   }
@@ -728,7 +1027,7 @@ int average_flag;      /* flag that signals bi-directional or Dual-Prime
         }
      
         s+= lx2;
-        d+= lx2;
+        d+= dlx2;
       }
     }
     else
@@ -758,7 +1057,7 @@ int average_flag;      /* flag that signals bi-directional or Dual-Prime
         }
 
         s+= lx2;
-        d+= lx2;
+        d+= dlx2;
       }
     }
   }
@@ -794,7 +1093,7 @@ int average_flag;      /* flag that signals bi-directional or Dual-Prime
         }
      
         s+= lx2;
-        d+= lx2;
+        d+= dlx2;
       }
     }
     else
@@ -824,7 +1123,7 @@ int average_flag;      /* flag that signals bi-directional or Dual-Prime
         }
 
         s+= lx2;
-        d+= lx2;
+        d+= dlx2;
       }
     }
   }
@@ -864,7 +1163,7 @@ int average_flag;      /* flag that signals bi-directional or Dual-Prime
         }
      
         s+= lx2;
-        d+= lx2;
+        d+= dlx2;
       }
     }
     else
@@ -898,8 +1197,260 @@ int average_flag;      /* flag that signals bi-directional or Dual-Prime
         }
 
         s+= lx2;
-        d+= lx2;
+        d+= dlx2;
       }
     }
   }
 }
+
+/* The kernels are instances of one of the inlined functions above with
+ * constant half-pel flags and average_flag, and for the fixed sizes with
+ * constant w and h as well: KERNELS(name,...) defines the eight kernels
+ * name_full, name_x, name_y, name_xy, name_full_avg etc. that body()
+ * gives for W by H samples, which PRED() lists in the order of pred[][].
+ */
+#define KERNEL(name,target,body,W,H,xh,yh,average_flag) \
+static target void name(s,d,lx,lx2,dlx2,w,h) \
+unsigned char *s, *d; \
+int lx, lx2, dlx2, w, h; \
+{ \
+  body(s,d,lx,lx2,dlx2,W,H,xh,yh,average_flag); \
+}
+
+#define KERNELS(name,target,body,W,H) \
+  KERNEL(name##_full,target,body,W,H,0,0,0) \
+  KERNEL(name##_x,target,body,W,H,1,0,0) \
+  KERNEL(name##_y,target,body,W,H,0,1,0) \
+  KERNEL(name##_xy,target,body,W,H,1,1,0) \
+  KERNEL(name##_full_avg,target,body,W,H,0,0,1) \
+  KERNEL(name##_x_avg,target,body,W,H,1,0,1) \
+  KERNEL(name##_y_avg,target,body,W,H,0,1,1) \
+  KERNEL(name##_xy_avg,target,body,W,H,1,1,1)
+
+#define PRED(name) \
+  {{name##_full, name##_x, name##_y, name##_xy}, \
+   {name##_full_avg, name##_x_avg, name##_y_avg, name##_xy_avg}}
+
+/* all sizes, in the order of PRED_ANY etc. */
+#define SIZES(target,body,isa) \
+  KERNELS(pred_##isa,target,body,w,h) \
+  KERNELS(pred_16x16_##isa,target,body,16,16) \
+  KERNELS(pred_16x8_##isa,target,body,16,8) \
+  KERNELS(pred_8x16_##isa,target,body,8,16) \
+  KERNELS(pred_8x8_##isa,target,body,8,8) \
+  KERNELS(pred_8x4_##isa,target,body,8,4)
+
+#define PRED_SIZES_OF(isa) \
+  {PRED(pred_##isa), PRED(pred_16x16_##isa), PRED(pred_16x8_##isa), \
+   PRED(pred_8x16_##isa), PRED(pred_8x8_##isa), PRED(pred_8x4_##isa)}
+
+SIZES(,predict_c,c)
+
+#ifdef HAVE_X86_SIMD
+
+/* The SIMD versions form 16 samples at a time, and the last 8 of rows
+ * whose width is not a multiple of 16. The rounded average of two samples
+ * (half-pel in one direction, and averaging with the prediction already
+ * at d) is exactly what pavgb computes; the sum of four for half-pel in
+ * both directions is formed in 16 bit lanes.
+ */
+
+static int have_sse2()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse2");
+}
+
+static int have_avx2()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+/* n==16 or n==8 samples from p on, the others zero */
+static __inline__ SIMD_TARGET("sse2") __m128i load_sse2(p,n)
+unsigned char *p;
+int n;
+{
+  return (n==16) ? _mm_loadu_si128((__m128i *)p)
+                 : _mm_loadl_epi64((__m128i *)p);
+}
+
+static __inline__ SIMD_TARGET("sse2") void store_sse2(p,v,n)
+unsigned char *p;
+__m128i v;
+int n;
+{
+  if (n==16)
+    _mm_storeu_si128((__m128i *)p,v);
+  else
+    _mm_storel_epi64((__m128i *)p,v);
+}
+
+/* (a+b+c+e+2)>>2 */
+static __inline__ SIMD_TARGET("sse2") __m128i avg4_sse2(a,b,c,e)
+__m128i a, b, c, e;
+{
+  __m128i z, lo, hi;
+
+  z = _mm_setzero_si128();
+  lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a,z),_mm_unpacklo_epi8(b,z)),
+                     _mm_add_epi16(_mm_unpacklo_epi8(c,z),_mm_unpacklo_epi8(e,z)));
+  hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a,z),_mm_unpackhi_epi8(b,z)),
+                     _mm_add_epi16(_mm_unpackhi_epi8(c,z),_mm_unpackhi_epi8(e,z)));
+  lo = _mm_srli_epi16(_mm_add_epi16(lo,_mm_set1_epi16(2)),2);
+  hi = _mm_srli_epi16(_mm_add_epi16(hi,_mm_set1_epi16(2)),2);
+
+  return _mm_packus_epi16(lo,hi);
+}
+
+/* n samples of one row */
+static __inline__ SIMD_TARGET("sse2") void row_sse2(s,d,lx,n,xh,yh,average_flag)
+unsigned char *s, *d;
+int lx, n;
+int xh, yh, average_flag;
+{
+  __m128i v;
+
+  if (xh && yh)
+    v = avg4_sse2(load_sse2(s,n),load_sse2(s+1,n),
+                  load_sse2(s+lx,n),load_sse2(s+lx+1,n));
+  else if (xh)
+    v = _mm_avg_epu8(load_sse2(s,n),load_sse2(s+1,n));
+  else if (yh)
+    v = _mm_avg_epu8(load_sse2(s,n),load_sse2(s+lx,n));
+  else
+    v = load_sse2(s,n);
+
+  if (average_flag)
+    v = _mm_avg_epu8(v,load_sse2(d,n));
+
+  store_sse2(d,v,n);
+}
+
+ALWAYS_INLINE SIMD_TARGET("sse2") void predict_sse2(s,d,lx,lx2,dlx2,w,h,xh,yh,average_flag)
+unsigned char *s, *d;
+int lx, lx2, dlx2, w, h;
+int xh, yh, average_flag;
+{
+  int i, j;
+
+  for (j=0; j<h; j++)
+  {
+    for (i=0; i+16<=w; i+=16)
+      row_sse2(s+i,d+i,lx,16,xh,yh,average_flag);
+    if (w & 8)
+      row_sse2(s+i,d+i,lx,8,xh,yh,average_flag);
+
+    s+= lx2;
+    d+= dlx2;
+  }
+}
+
+SIZES(SIMD_TARGET("sse2"),predict_sse2,sse2)
+
+/* with AVX2 the sum of four is formed in one register of 16 bit lanes */
+ALWAYS_INLINE SIMD_TARGET("avx2") void predict_xy_avx2(s,d,lx,lx2,dlx2,w,h,average_flag)
+unsigned char *s, *d;
+int lx, lx2, dlx2, w, h;
+int average_flag;
+{
+  __m256i v;
+  __m128i r;
+  int i, j;
+
+  for (j=0; j<h; j++)
+  {
+    for (i=0; i+16<=w; i+=16)
+    {
+      v = _mm256_add_epi16(
+            _mm256_add_epi16(
+              _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *)(s+i))),
+              _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *)(s+i+1)))),
+            _mm256_add_epi16(
+              _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *)(s+i+lx))),
+              _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *)(s+i+lx+1)))));
+      v = _mm256_srli_epi16(_mm256_add_epi16(v,_mm256_set1_epi16(2)),2);
+      r = _mm_packus_epi16(_mm256_castsi256_si128(v),
+                           _mm256_extracti128_si256(v,1));
+      if (average_flag)
+        r = _mm_avg_epu8(r,_mm_loadu_si128((__m128i *)(d+i)));
+      _mm_storeu_si128((__m128i *)(d+i),r);
+    }
+    if (w & 8)
+      row_sse2(s+i,d+i,lx,8,1,1,average_flag);
+
+    s+= lx2;
+    d+= dlx2;
+  }
+}
+
+ALWAYS_INLINE SIMD_TARGET("avx2") void predict_avx2(s,d,lx,lx2,dlx2,w,h,xh,yh,average_flag)
+unsigned char *s, *d;
+int lx, lx2, dlx2, w, h;
+int xh, yh, average_flag;
+{
+  if (xh && yh)
+    predict_xy_avx2(s,d,lx,lx2,dlx2,w,h,average_flag);
+  else
+    predict_sse2(s,d,lx,lx2,dlx2,w,h,xh,yh,average_flag);
+}
+
+SIZES(SIMD_TARGET("avx2"),predict_avx2,avx2)
+
+#endif /* HAVE_X86_SIMD */
+
+static struct prediction_kernels kernels[] =
+{
+  {"c", NULL, PRED_SIZES_OF(c)},
+#ifdef HAVE_X86_SIMD
+  {"sse2", have_sse2, PRED_SIZES_OF(sse2)},
+  {"avx2", have_avx2, PRED_SIZES_OF(avx2)},
+#endif
+};
+
+/* make form_component_prediction() use the best loops this CPU can run,
+   or the C ones, which trace their samples, with TRACE_RECON */
+void Initialize_Prediction()
+{
+  int i;
+
+  for (i=sizeof(kernels)/sizeof(kernels[0])-1; i>0; i--)
+    if (kernels[i].usable==NULL || kernels[i].usable())
+      break;
+
+#ifdef TRACE_RECON
+  i = 0;
+#endif /* TRACE_RECON */
+
+  predict = &kernels[i];
+}
+
+/* set up the kernels form_prediction() uses for the chroma format of the
+   sequence */
+void Select_Prediction_Kernels()
+{
+  int chroma16x16, chroma16x8;
+
+  if (chroma_format==CHROMA420)
+  {
+    chroma16x16 = PRED_8x8;
+    chroma16x8 = PRED_8x4;
+  }
+  else if (chroma_format==CHROMA422)
+  {
+    chroma16x16 = PRED_8x16;
+    chroma16x8 = PRED_8x8;
+  }
+  else
+  {
+    chroma16x16 = PRED_16x16;
+    chroma16x8 = PRED_16x8;
+  }
+
+  sized_pred[0][0] = sized_pred[0][1] = predict->pred[PRED_ANY];
+  sized_pred[1][0] = predict->pred[PRED_16x16];
+  sized_pred[1][1] = predict->pred[chroma16x16];
+  sized_pred[2][0] = predict->pred[PRED_16x8];
+  sized_pred[2][1] = predict->pred[chroma16x8];
+}
@@ -8,9 +8,9 @@ static void Read_Lower_Layer_Component_Framewise _ANSI_ARGS_((int comp, int lw,
 static void Read_Lower_Layer_Component_Fieldwise _ANSI_ARGS_((int comp, int lw, int lh));
 static void Make_Spatial_Prediction_Frame _ANSI_ARGS_((int progressive_frame,
   int llprogressive_frame, unsigned char *fld0, unsigned char *fld1, 
-  short *tmp, unsigned char *dst, int llx0, int lly0, int llw, int llh, 
-  int horizontal_size, int vertical_size, int vm, int vn, int hm, int hn, 
-  int aperture));
+  short *tmp, unsigned char *dst, int lxd, int llx0, int lly0, int llw,
+  int llh, int horizontal_size, int vertical_size, int vm, int vn, int hm,
+  int hn, int aperture));
 static void Deinterlace _ANSI_ARGS_((unsigned char *fld0, unsigned char *fld1,
   int j0, int lx, int ly, int aperture));
 static void Subsample_Vertical _ANSI_ARGS_((unsigned char *s, short *d,
@@ -46,7 +46,7 @@ void Spatial_Prediction()
 
   Make_Spatial_Prediction_Frame  /* Y */
     (progressive_frame,lower_layer_progressive_frame,llframe0[0],llframe1[0],
-     lltmp,current_frame[0],lower_layer_horizontal_offset,
+     lltmp,current_frame[0],Coded_Picture_Stride,lower_layer_horizontal_offset,
      lower_layer_vertical_offset,
      lower_layer_prediction_horizontal_size,
      lower_layer_prediction_vertical_size,
@@ -57,7 +57,7 @@ void Spatial_Prediction()
 
   Make_Spatial_Prediction_Frame  /* Cb */
     (progressive_frame,lower_layer_progressive_frame,llframe0[1],llframe1[1],
-     lltmp,current_frame[1],lower_layer_horizontal_offset/2,
+     lltmp,current_frame[1],Chroma_Stride,lower_layer_horizontal_offset/2,
      lower_layer_vertical_offset/2,
      lower_layer_prediction_horizontal_size>>1,
      lower_layer_prediction_vertical_size>>1,
@@ -67,7 +67,7 @@ void Spatial_Prediction()
 
   Make_Spatial_Prediction_Frame  /* Cr */
     (progressive_frame,lower_layer_progressive_frame,llframe0[2],llframe1[2],
-     lltmp,current_frame[2],lower_layer_horizontal_offset/2,
+     lltmp,current_frame[2],Chroma_Stride,lower_layer_horizontal_offset/2,
      lower_layer_vertical_offset/2,
      lower_layer_prediction_horizontal_size>>1,
      lower_layer_prediction_vertical_size>>1,
@@ -150,12 +150,13 @@ static void Read_Lower_Layer_Component_Fieldwise(comp,lw,lh)
 
 /* form spatial prediction */
 static void Make_Spatial_Prediction_Frame(progressive_frame,
-  llprogressive_frame,fld0,fld1,tmp,dst,llx0,lly0,llw,llh,horizontal_size,
-  vertical_size,vm,vn,hm,hn,aperture)
+  llprogressive_frame,fld0,fld1,tmp,dst,lxd,llx0,lly0,llw,llh,
+  horizontal_size,vertical_size,vm,vn,hm,hn,aperture)
 int progressive_frame,llprogressive_frame;
 unsigned char *fld0,*fld1;
 short *tmp;
 unsigned char *dst;
+int lxd; /* line stride of dst */
 int llx0,lly0,llw,llh,horizontal_size,vertical_size,vm,vn,hm,hn,aperture;
 {
   int w, h, x0, llw2, llh2;
@@ -202,7 +203,7 @@ int llx0,lly0,llw,llh,horizontal_size,vertical_size,vm,vn,hm,hn,aperture;
     }
     else
     {
-      dst+= horizontal_size*lly0;
+      dst+= lxd*lly0;
       h= vertical_size - lly0;
       if (h>llh2)
         h = llh2;
@@ -226,7 +227,7 @@ int llx0,lly0,llw,llh,horizontal_size,vertical_size,vm,vn,hm,hn,aperture;
         w = llw2;
     }
   
-  Subsample_Horizontal(tmp,dst,x0,w,llw,horizontal_size,h,hm,hn);
+  Subsample_Horizontal(tmp,dst,x0,w,llw,lxd,h,hm,hn);
 }
 
 /* deinterlace one field (interpolate opposite parity samples)
@@ -30,6 +30,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <time.h>
 
 #include "config.h"
 #include "global.h"
@@ -50,45 +51,136 @@ static void store_yuv1 _ANSI_ARGS_((char *name, unsigned char *src,
   int offset, int incr, int width, int height));
 static void putbyte _ANSI_ARGS_((int c));
 static void putword _ANSI_ARGS_((int w));
+static double PTS_Difference _ANSI_ARGS_((long long a, long long b));
+static void Pace_Frame _ANSI_ARGS_((int frame, long long pts));
 
 #define OBFRSIZE 4096
-static unsigned char obfr[OBFRSIZE];
-static unsigned char *optr;
-static int outfile;
+static THREAD_LOCAL unsigned char obfr[OBFRSIZE];
+static THREAD_LOCAL unsigned char *optr;
+static THREAD_LOCAL int outfile;
+
+/* output timing: PTS of the last frame written, and for -w the wall
+   clock time and PTS of the first frame the others are paced from */
+static THREAD_LOCAL long long Last_PTS = -1;
+static THREAD_LOCAL struct timespec Epoch;
+static THREAD_LOCAL long long Epoch_PTS = -1;
+static THREAD_LOCAL long Early_Frames, Late_Frames;
+static THREAD_LOCAL double Max_Early, Max_Late;
+
+/* a - b in seconds, for 33-bit time stamps that wrap around */
+static double PTS_Difference(a,b)
+long long a, b;
+{
+  long long d;
+
+  d = (a - b) & ((1LL<<33) - 1);
+  if (d >= (1LL<<32))
+    d -= 1LL<<33;
+  return d / 90000.0;
+}
+
+/* wait until the frame is due: Output_Delay ms plus its time stamp past
+ * those of the first frame, on the wall clock; frames that are due already
+ * are late and written right away
+ */
+static void Pace_Frame(frame,pts)
+int frame;
+long long pts;
+{
+  struct timespec now, ts;
+  double t;
+
+  clock_gettime(CLOCK_MONOTONIC,&now);
+
+  /* first frame, or a jump in the time base */
+  if (Epoch_PTS<0 || PTS_Difference(pts,Last_PTS)>10.0 || PTS_Difference(pts,Last_PTS)<-10.0)
+  {
+    Epoch = now;
+    Epoch_PTS = pts;
+  }
+
+  /* seconds until the frame is due */
+  t = PTS_Difference(pts,Epoch_PTS) + Output_Delay/1000.0
+      - (now.tv_sec - Epoch.tv_sec) - (now.tv_nsec - Epoch.tv_nsec)/1e9;
+
+  if (t>0)
+  {
+    Early_Frames++;
+    if (t>Max_Early)
+      Max_Early = t;
+    ts.tv_sec = (time_t)t;
+    ts.tv_nsec = (long)((t - ts.tv_sec)*1e9);
+    while (nanosleep(&ts,&ts))
+      ;
+  }
+  else
+  {
+    Late_Frames++;
+    if (-t>Max_Late)
+      Max_Late = -t;
+  }
+
+  if (Verbose_Flag>=PICTURE_LAYER)
+    printf("frame %d pts %.3f: %s by %.1f ms\n",frame,pts/90000.0,
+      t>0 ? "early" : "late",(t>0 ? t : -t)*1000.0);
+}
+
+/* early and late frames of -w */
+void Print_Output_Timing()
+{
+  if (Output_Delay<0)
+    return;
+
+  printf("output timing: %ld of %ld frames late (by up to %.1f ms), others early by up to %.1f ms\n",
+    Late_Frames,Early_Frames+Late_Frames,Max_Late*1000.0,Max_Early*1000.0);
+}
 
 /*
- * store a picture as either one frame or two fields
+ * store a picture as either one frame or two fields, at its presentation
+ * time pts (90 kHz units) with -w; frames without a time stamp are
+ * presented a frame period after the previous one
  */
-void Write_Frame(src,frame)
+void Write_Frame(src,frame,pts)
 unsigned char *src[];
 int frame;
+long long pts;
 {
   char outname[FILENAME_LENGTH];
 
+  if (pts<0)
+    pts = Last_PTS<0 ? 0 : (Last_PTS + (long long)(90000.0/(frame_rate>0 ? frame_rate : 25.0))) & ((1LL<<33) - 1);
+
+  if (Output_Delay>=0)
+    Pace_Frame(frame,pts);
+  else if (Verbose_Flag>=PICTURE_LAYER)
+    printf("frame %d pts %.3f\n",frame,pts/90000.0);
+
+  Last_PTS = pts;
+
   if (progressive_sequence || progressive_frame || Frame_Store_Flag)
   {
     /* progressive */
     sprintf(outname,Output_Picture_Filename,frame,'f');
-    store_one(outname,src,0,Coded_Picture_Width,vertical_size);
+    store_one(outname,src,0,Coded_Picture_Stride,vertical_size);
   }
   else
   {
     /* interlaced */
     sprintf(outname,Output_Picture_Filename,frame,'a');
-    store_one(outname,src,0,Coded_Picture_Width<<1,vertical_size>>1);
+    store_one(outname,src,0,Coded_Picture_Stride<<1,vertical_size>>1);
 
     sprintf(outname,Output_Picture_Filename,frame,'b');
     store_one(outname,src,
-      Coded_Picture_Width,Coded_Picture_Width<<1,vertical_size>>1);
+      Coded_Picture_Stride,Coded_Picture_Stride<<1,vertical_size>>1);
   }
     sprintf(outname,"frame_%02d_out_",frame);
-    store_one(outname,src,0,Coded_Picture_Width,vertical_size);
+    store_one(outname,src,0,Coded_Picture_Stride,vertical_size);
     sprintf(outname,"frame_%02d_fwd_",frame);
-    store_one(outname,forward_reference_frame,0,Coded_Picture_Width,vertical_size);
+    store_one(outname,forward_reference_frame,0,Coded_Picture_Stride,vertical_size);
     sprintf(outname,"frame_%02d_bwd_",frame);
-    store_one(outname,backward_reference_frame,0,Coded_Picture_Width,vertical_size);
+    store_one(outname,backward_reference_frame,0,Coded_Picture_Stride,vertical_size);
     sprintf(outname,"frame_%02d_aux_",frame);
-    store_one(outname,auxframe,0,Coded_Picture_Width,vertical_size);
+    store_one(outname,auxframe,0,Coded_Picture_Stride,vertical_size);
 }
 
 /*
@@ -196,7 +288,7 @@ int offset, incr, height;
 {
   int i,j;
   unsigned char *py, *pu, *pv;
-  static unsigned char *u422, *v422;
+  static THREAD_LOCAL unsigned char *u422, *v422;
 
   if (chroma_format==CHROMA444)
     Error("4:4:4 not supported for SIF format");
@@ -210,10 +302,10 @@ int offset, incr, height;
   {
     if (!u422)
     {
-      if (!(u422 = (unsigned char *)malloc((Coded_Picture_Width>>1)
+      if (!(u422 = (unsigned char *)malloc((Coded_Picture_Stride>>1)
                                            *Coded_Picture_Height)))
         Error("malloc failed");
-      if (!(v422 = (unsigned char *)malloc((Coded_Picture_Width>>1)
+      if (!(v422 = (unsigned char *)malloc((Coded_Picture_Stride>>1)
                                            *Coded_Picture_Height)))
         Error("malloc failed");
     }
@@ -269,9 +361,9 @@ int tgaflag;
   int y, u, v, r, g, b;
   int crv, cbu, cgu, cgv;
   unsigned char *py, *pu, *pv;
-  static unsigned char tga24[14] = {0,0,2,0,0,0,0, 0,0,0,0,0,24,32};
+  static THREAD_LOCAL unsigned char tga24[14] = {0,0,2,0,0,0,0, 0,0,0,0,0,24,32};
   char header[FILENAME_LENGTH];
-  static unsigned char *u422, *v422, *u444, *v444;
+  static THREAD_LOCAL unsigned char *u422, *v422, *u444, *v444;
 
   if (chroma_format==CHROMA444)
   {
@@ -284,19 +376,19 @@ int tgaflag;
     {
       if (chroma_format==CHROMA420)
       {
-        if (!(u422 = (unsigned char *)malloc((Coded_Picture_Width>>1)
+        if (!(u422 = (unsigned char *)malloc((Coded_Picture_Stride>>1)
                                              *Coded_Picture_Height)))
           Error("malloc failed");
-        if (!(v422 = (unsigned char *)malloc((Coded_Picture_Width>>1)
+        if (!(v422 = (unsigned char *)malloc((Coded_Picture_Stride>>1)
                                              *Coded_Picture_Height)))
           Error("malloc failed");
       }
 
-      if (!(u444 = (unsigned char *)malloc(Coded_Picture_Width
+      if (!(u444 = (unsigned char *)malloc(Coded_Picture_Stride
                                            *Coded_Picture_Height)))
         Error("malloc failed");
 
-      if (!(v444 = (unsigned char *)malloc(Coded_Picture_Width
+      if (!(v444 = (unsigned char *)malloc(Coded_Picture_Stride
                                            *Coded_Picture_Height)))
         Error("malloc failed");
     }
@@ -437,7 +529,8 @@ int w;
   putbyte(w); putbyte(w>>8);
 }
 
-/* horizontal 1:2 interpolation filter */
+/* horizontal 1:2 interpolation filter, of lines as far apart as those of
+   the picture buffers */
 void conv422to444(src,dst)
 unsigned char *src,*dst;
 {
@@ -467,8 +560,8 @@ unsigned char *src,*dst;
                         -52*(src[im1]+src[ip2]) 
                        +159*(src[i]+src[ip1])+128)>>8];
       }
-      src+= w;
-      dst+= Coded_Picture_Width;
+      src+= Coded_Picture_Stride>>1;
+      dst+= Coded_Picture_Stride;
     }
   }
   else
@@ -501,21 +594,23 @@ unsigned char *src,*dst;
                          -37*src[im1]
                          +11*src[im2]+128)>>8];
       }
-      src+= w;
-      dst+= Coded_Picture_Width;
+      src+= Coded_Picture_Stride>>1;
+      dst+= Coded_Picture_Stride;
     }
   }
 }
 
-/* vertical 1:2 interpolation filter */
+/* vertical 1:2 interpolation filter, of lines as far apart as those of the
+   picture buffers */
 void conv420to422(src,dst)
 unsigned char *src,*dst;
 {
-  int w, h, i, j, j2;
+  int w, h, lx, i, j, j2;
   int jm6, jm5, jm4, jm3, jm2, jm1, jp1, jp2, jp3, jp4, jp5, jp6, jp7;
 
   w = Coded_Picture_Width>>1;
   h = Coded_Picture_Height>>1;
+  lx = Coded_Picture_Stride>>1;
 
   if (progressive_frame)
   {
@@ -534,19 +629,19 @@ unsigned char *src,*dst;
 
         /* FIR filter coefficients (*256): 5 -21 70 228 -37 11 */
         /* New FIR filter coefficients (*256): 3 -16 67 227 -32 7 */
-        dst[w*j2] =     Clip[(int)(  3*src[w*jm3]
-                             -16*src[w*jm2]
-                             +67*src[w*jm1]
-                            +227*src[w*j]
-                             -32*src[w*jp1]
-                             +7*src[w*jp2]+128)>>8];
-
-        dst[w*(j2+1)] = Clip[(int)(  3*src[w*jp3]
-                             -16*src[w*jp2]
-                             +67*src[w*jp1]
-                            +227*src[w*j]
-                             -32*src[w*jm1]
-                             +7*src[w*jm2]+128)>>8];
+        dst[lx*j2] =     Clip[(int)(  3*src[lx*jm3]
+                             -16*src[lx*jm2]
+                             +67*src[lx*jm1]
+                            +227*src[lx*j]
+                             -32*src[lx*jp1]
+                             +7*src[lx*jp2]+128)>>8];
+
+        dst[lx*(j2+1)] = Clip[(int)(  3*src[lx*jp3]
+                             -16*src[lx*jp2]
+                             +67*src[lx*jp1]
+                            +227*src[lx*j]
+                             -32*src[lx*jm1]
+                             +7*src[lx*jm2]+128)>>8];
       }
       src++;
       dst++;
@@ -571,21 +666,21 @@ unsigned char *src,*dst;
 
         /* Polyphase FIR filter coefficients (*256): 2 -10 35 242 -18 5 */
         /* New polyphase FIR filter coefficients (*256): 1 -7 30 248 -21 5 */
-        dst[w*j2] = Clip[(int)(  1*src[w*jm6]
-                         -7*src[w*jm4]
-                         +30*src[w*jm2]
-                        +248*src[w*j]
-                         -21*src[w*jp2]
-                          +5*src[w*jp4]+128)>>8];
+        dst[lx*j2] = Clip[(int)(  1*src[lx*jm6]
+                         -7*src[lx*jm4]
+                         +30*src[lx*jm2]
+                        +248*src[lx*j]
+                         -21*src[lx*jp2]
+                          +5*src[lx*jp4]+128)>>8];
 
         /* Polyphase FIR filter coefficients (*256): 11 -38 192 113 -30 8 */
         /* New polyphase FIR filter coefficients (*256):7 -35 194 110 -24 4 */
-        dst[w*(j2+2)] = Clip[(int)( 7*src[w*jm4]
-                             -35*src[w*jm2]
-                            +194*src[w*j]
-                            +110*src[w*jp2]
-                             -24*src[w*jp4]
-                              +4*src[w*jp6]+128)>>8];
+        dst[lx*(j2+2)] = Clip[(int)( 7*src[lx*jm4]
+                             -35*src[lx*jm2]
+                            +194*src[lx*j]
+                            +110*src[lx*jp2]
+                             -24*src[lx*jp4]
+                              +4*src[lx*jp6]+128)>>8];
 
         /* bottom field */
         jm5 = (j<5) ? 1 : j-5;
@@ -598,19 +693,19 @@ unsigned char *src,*dst;
 
         /* Polyphase FIR filter coefficients (*256): 11 -38 192 113 -30 8 */
         /* New polyphase FIR filter coefficients (*256):7 -35 194 110 -24 4 */
-        dst[w*(j2+1)] = Clip[(int)( 7*src[w*jp5]
-                             -35*src[w*jp3]
-                            +194*src[w*jp1]
-                            +110*src[w*jm1]
-                             -24*src[w*jm3]
-                              +4*src[w*jm5]+128)>>8];
-
-        dst[w*(j2+3)] = Clip[(int)(  1*src[w*jp7]
-                             -7*src[w*jp5]
-                             +30*src[w*jp3]
-                            +248*src[w*jp1]
-                             -21*src[w*jm1]
-                              +5*src[w*jm3]+128)>>8];
+        dst[lx*(j2+1)] = Clip[(int)( 7*src[lx*jp5]
+                             -35*src[lx*jp3]
+                            +194*src[lx*jp1]
+                            +110*src[lx*jm1]
+                             -24*src[lx*jm3]
+                              +4*src[lx*jm5]+128)>>8];
+
+        dst[lx*(j2+3)] = Clip[(int)(  1*src[lx*jp7]
+                             -7*src[lx*jp5]
+                             +30*src[lx*jp3]
+                            +248*src[lx*jp1]
+                             -21*src[lx*jm1]
+                              +5*src[lx*jm3]+128)>>8];
       }
       src++;
       dst++;
@@ -39,7 +39,7 @@
 static void Read_Frame _ANSI_ARGS_((char *filename, 
   unsigned char *frame_buffer[], int framenum));
 static void Copy_Frame _ANSI_ARGS_((unsigned char *src, unsigned char *dst, 
-  int width, int height, int parity, int incr));
+  int width, int stride, int height, int parity, int incr));
 static int Read_Components _ANSI_ARGS_ ((char *filename, 
   unsigned char *frame[3], int framenum));
 static int Read_Component _ANSI_ARGS_ ((char *fname, unsigned char *frame, 
@@ -54,12 +54,12 @@ int bitstream_framenum;
 int sequence_framenum;
 {
   /* static tracking variables */
-  static int previous_temporal_reference;
-  static int previous_bitstream_framenum;
-  static int previous_anchor_temporal_reference;
-  static int previous_anchor_bitstream_framenum;
-  static int previous_picture_coding_type;
-  static int bgate;
+  static THREAD_LOCAL int previous_temporal_reference;
+  static THREAD_LOCAL int previous_bitstream_framenum;
+  static THREAD_LOCAL int previous_anchor_temporal_reference;
+  static THREAD_LOCAL int previous_anchor_bitstream_framenum;
+  static THREAD_LOCAL int previous_picture_coding_type;
+  static THREAD_LOCAL int bgate;
   
   /* local temporary variables */
   int substitute_display_framenum;
@@ -160,6 +160,8 @@ int framenum;
   int parity;
   int rerr = 0;
   int field_mode;
+  int cc, lx;
+  unsigned char *dst[3];
 
   if(framenum<0)
     printf("ERROR: framenum (%d) is less than zero\n", framenum);
@@ -193,19 +195,35 @@ int framenum;
   }
 
 
-  Copy_Frame(substitute_frame[0], frame[0], Coded_Picture_Width, 
-    Coded_Picture_Height, parity, field_mode);
+  /* a field goes to the first field of the frame: frame[] is
+     current_frame[], which points at the current field */
+  for (cc=0; cc<3; cc++)
+  {
+    dst[cc] = frame[cc];
+    if (field_mode)
+    {
+      lx = (cc==0) ? Coded_Picture_Stride : Chroma_Stride;
+      dst[cc]+= parity ? lx : -lx;
+    }
+  }
+
+  Copy_Frame(substitute_frame[0], dst[0], Coded_Picture_Width, 
+    Coded_Picture_Stride, Coded_Picture_Height, parity, field_mode);
   
-  Copy_Frame(substitute_frame[1], frame[1], Chroma_Width, Chroma_Height, 
-    parity, field_mode);
+  Copy_Frame(substitute_frame[1], dst[1], Chroma_Width, Chroma_Stride,
+    Chroma_Height, parity, field_mode);
   
-  Copy_Frame(substitute_frame[2], frame[2], Chroma_Width, Chroma_Height,
-    parity, field_mode);
+  Copy_Frame(substitute_frame[2], dst[2], Chroma_Width, Chroma_Stride,
+    Chroma_Height, parity, field_mode);
+
+  /* the edge around the substituted reference frame or field, which
+     the predictions of the current picture may read */
+  Extend_Edges(dst,field_mode ? TOP_FIELD : FRAME_PICTURE);
 
 #ifdef VERBOSE
   if(Verbose_Flag > NO_LAYER)
     printf("substituted %s %d\n",
-      (field_mode ? (parity?"bottom field":"bottom field"):"frame"), framenum);
+      (field_mode ? (parity?"bottom field":"top field"):"frame"), framenum);
 #endif
 }
 
@@ -346,10 +364,11 @@ int framenum;
 }
 
 
-static void Copy_Frame(src, dst, width, height, parity, field_mode)
+static void Copy_Frame(src, dst, width, stride, height, parity, field_mode)
 unsigned char *src;
 unsigned char *dst;
 int width;
+int stride;        /* line stride of dst */
 int height;
 int parity;        /* field parity (top or bottom) to overwrite */
 int field_mode;    /* 0 = frame, 1 = field                      */
@@ -369,7 +388,8 @@ int field_mode;    /* 0 = frame, 1 = field                      */
   {
     incr = 2;
 
-    if(parity==0)
+    /* the lines of the field in the substitute frame */
+    if(parity==1)
       s += width;
   }
   else
@@ -384,7 +404,7 @@ int field_mode;    /* 0 = frame, 1 = field                      */
       dst[d+col] = src[s+col];
     }
     
-    d += (width*incr);
+    d += (stride*incr);
     s += (width*incr);
   }
 
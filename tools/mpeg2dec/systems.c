@@ -29,162 +29,801 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "config.h"
 #include "global.h"
 
+static int Packet_Header _ANSI_ARGS_((void));
+static int Packet_Header_Bytewise _ANSI_ARGS_((void));
+static void End_Of_Stream _ANSI_ARGS_((void));
+static void Next_Transport_Packet _ANSI_ARGS_((void));
+static int Bytes_Left _ANSI_ARGS_((long end));
+static int Transport_PES_Header _ANSI_ARGS_((long end));
+static int Transport_PES_Header_Bytewise _ANSI_ARGS_((long end));
+static void Program_Association _ANSI_ARGS_((long end));
+static void Program_Map _ANSI_ARGS_((long end));
+static long long Get_Timestamp _ANSI_ARGS_((unsigned char *p));
+static long long Read_Timestamp _ANSI_ARGS_((int first));
+static void Add_Timestamp _ANSI_ARGS_((void));
+
+/* transport streams: sync bytes still to be seen a packet apart before
+   the packets are trusted again, 0 while in sync */
+static THREAD_LOCAL int Sync_Lost;
+#define SYNC_CONFIRM 3
+
+/* time stamps of the PES header just parsed, for Add_Timestamp() */
+static THREAD_LOCAL long long PES_PTS = -1, PES_DTS = -1;
+
+/* system layer headers are parsed in place, once a single check has found
+   the longest form of the header in the input buffer; those that cross
+   the end of the buffer are read a byte at a time, with Get_Byte()
+   refilling it */
+#define HEADER_FITS(n) (ld->Rdend - ld->Rdptr >= (n))
+
+/* the longest pack header after its start code: ISO/IEC 13818-1, up to
+   pack_stuffing_length */
+#define PACK_HEADER_MAX 10
+
+/* the longest video packet header Packet_Header() parses in place:
+   packet_length, 16 stuffing bytes, STD_buffer_size and both time stamps
+   of an ISO/IEC 11172-1 packet */
+#define PACKET_HEADER_MAX 30
+
+/* next byte of a system layer header that crosses the end of the input
+   buffer */
+INLINE int Header_Byte()
+{
+  if (ld->Rdptr < ld->Rdend)
+    return *ld->Rdptr++;
+  return Get_Byte();
+}
+
+INLINE int Header_Word()
+{
+  int Val;
+
+  Val = Header_Byte();
+  return (Val<<8) | Header_Byte();
+}
+
 /* initialize buffer, call once before first getbits or showbits */
 
-/* parse system layer, ignore everything we don't need */
+/* program stream (and MPEG-1 system stream) demultiplexer
+ *
+ * Called when the video data of the current packet is used up. Walks the
+ * pack and PES headers in place and points Rdptr..Rdmax at the payload
+ * of the next packet of the selected video stream (-p stream_id, or the
+ * first of 0xe0..0xef found), for the bit reader to consume from the
+ * input buffer. Other packets are skipped by their length. Damaged
+ * headers do not stop decoding: they are counted in ld->Demux, and the
+ * demultiplexer resynchronizes at the next start code.
+ */
 void Next_Packet()
 {
+  unsigned char *p;
   unsigned int code;
-  int l;
+  long pos, len;
+
+  if (System_Stream_Flag==TRANSPORT_STREAM)
+  {
+    Next_Transport_Packet();
+    return;
+  }
+
+  /* video payload of the packet just finished */
+  len = Bitstream_Offset(ld->Rdmax) - ld->Pktdata;
 
   for(;;)
   {
-    code = Get_Long();
+    pos = Bitstream_Offset(ld->Rdptr);
+    if (HEADER_FITS(4))
+    {
+      p = ld->Rdptr;
+      code = ((unsigned int)p[0]<<24) | (p[1]<<16) | (p[2]<<8) | p[3];
+      ld->Rdptr += 4;
+    }
+    else
+    {
+      code = Header_Word()<<16;
+      code |= Header_Word();
+    }
 
-    /* remove system layer byte stuffing */
-    while ((code & 0xffffff00) != 0x100)
-      code = (code<<8) | Get_Byte();
+    /* not at a start code: resynchronize byte by byte */
+    if ((code & 0xffffff00) != 0x100)
+    {
+      if (Bitstream_Padding())
+      {
+        End_Of_Stream();
+        return;
+      }
+      ld->Demux.Sync_Errors++;
+      if (!Quiet_Flag)
+        fprintf(stderr,"system layer sync lost at byte %ld\n",pos);
+      while ((code & 0xffffff00) != 0x100)
+        code = (code<<8) | Header_Byte();
+      pos = Bitstream_Offset(ld->Rdptr) - 4;
+    }
 
     switch(code)
     {
     case PACK_START_CODE: /* pack header */
-      /* skip pack header (system_clock_reference and mux_rate) */
-      ld->Rdptr += 8;
+      /* skip system_clock_reference and mux_rate */
+      if (HEADER_FITS(PACK_HEADER_MAX))
+      {
+        p = ld->Rdptr;
+        if ((p[0]>>6)==0x01)
+          ld->Rdptr += 10 + (p[9] & 0x07);
+        else
+          ld->Rdptr += 8;
+      }
+      else if ((Header_Byte()>>6)==0x01)
+      {
+        /* ISO/IEC 13818-1 pack header, with pack_stuffing_length */
+        ld->Rdptr += 8;
+        ld->Rdptr += Header_Byte() & 0x07;
+      }
+      else
+        ld->Rdptr += 7;
       break;
-    case VIDEO_ELEMENTARY_STREAM:   
-      code = Get_Word();             /* packet_length */
-      ld->Rdmax = ld->Rdptr + code;
-
-      code = Get_Byte();
+    case ISO_END_CODE: /* end */
+      End_Of_Stream();
+      return;
+    default:
+      if (code<SYSTEM_START_CODE)
+      {
+        /* end of file without ISO 11172 end code */
+        if (Bitstream_Padding())
+        {
+          End_Of_Stream();
+          return;
+        }
+        ld->Demux.Header_Errors++;
+        if (!Quiet_Flag)
+          fprintf(stderr,"Unexpected startcode %08x in system layer\n",code);
+        break;
+      }
 
-      if((code>>6)==0x02)
+      if ((code & 0xfffffff0)==VIDEO_ELEMENTARY_STREAM
+          && (ld->Stream_Id<0 || (int)(code & 0xff)==ld->Stream_Id))
       {
-        ld->Rdptr++;
-        code=Get_Byte();  /* parse PES_header_data_length */
-        ld->Rdptr+=code;    /* advance pointer by PES_header_data_length */
+        ld->Stream_Id = code & 0xff;
+
+        if (!Packet_Header())
+        {
+          ld->Demux.Header_Errors++;
+          if (!Quiet_Flag)
+            fprintf(stderr,"Error in packet header at byte %ld\n",pos);
+          ld->Rdptr = ld->Rdmax;
+          break;
+        }
+        ld->Demux.Packets++;
+
+        if (ld->Rdptr==ld->Rdmax)
+          break;
+
+        /* keep track of where the video data of this packet and of the
+           previous one is, in the file and in the elementary stream */
+        ld->Prevpos = ld->Pktpos;
+        ld->Prevbase = ld->Pktbase;
+        ld->Pktbase += len;
+        ld->Pktpos = pos;
+        ld->Pktdata = Bitstream_Offset(ld->Rdptr);
+        Add_Timestamp();
         return;
       }
-      else if(code==0xff)
+
+      /* skip system headers and non-video packets*/
+      ld->Demux.Skipped++;
+      if (HEADER_FITS(2))
       {
-        /* parse MPEG-1 packet header */
-        while((code=Get_Byte())== 0xFF);
+        p = ld->Rdptr;
+        ld->Rdptr += 2 + ((p[0]<<8) | p[1]);
       }
-       
-      /* stuffing bytes */
-      if(code>=0x40)
+      else
       {
-        if(code>=0x80)
-        {
-          fprintf(stderr,"Error in packet header\n");
-          exit(1);
-        }
-        /* skip STD_buffer_scale */
-        ld->Rdptr++;
-        code = Get_Byte();
+        code = Header_Word();
+        ld->Rdptr += code;
+      }
+      break;
+    }
+  }
+}
+
+/* parse the rest of a video packet header, up to the first payload byte,
+   noting its time stamps; sets Rdmax to the end of the packet, returns 0
+   if the header is damaged */
+static int Packet_Header()
+{
+  unsigned char *p;
+  unsigned int code;
+  int n;
+
+  if (!HEADER_FITS(PACKET_HEADER_MAX))
+    return Packet_Header_Bytewise();
+
+  PES_PTS = PES_DTS = -1;
+
+  p = ld->Rdptr;
+  ld->Rdmax = p + 2 + ((p[0]<<8) | p[1]);  /* packet_length */
+  p += 2;
+  code = *p++;
+
+  if((code>>6)==0x02)
+  {
+    /* ISO/IEC 13818-1 PES packet header */
+    code = p[0];  /* PTS_DTS_flags ... */
+    n = p[1];     /* PES_header_data_length */
+    p += 2;
+    if (code & 0x80)
+    {
+      PES_PTS = Get_Timestamp(p);
+      p += 5;
+      n -= 5;
+      if (code & 0x40)
+      {
+        PES_DTS = Get_Timestamp(p);
+        p += 5;
+        n -= 5;
       }
+      if (n<0)
+        return 0;
+    }
+    p += n;
+  }
+  else
+  {
+    /* ISO/IEC 11172-1 packet header: stuffing bytes, of which there are
+       at most 16 (more are left to the bytewise parser) */
+    for (n=0; code==0xff && p < ld->Rdmax; n++)
+    {
+      if (n==16)
+        return Packet_Header_Bytewise();
+      code = *p++;
+    }
+
+    if ((code>>6)==0x01)
+    {
+      /* skip STD_buffer_scale and STD_buffer_size */
+      p++;
+      code = *p++;
+    }
 
-      if(code>=0x30)
+    if ((code>>4)==0x03)
+    {
+      /* presentation and decoding time stamps */
+      PES_PTS = Get_Timestamp(p-1);
+      PES_DTS = Get_Timestamp(p+4);
+      p += 9;
+    }
+    else if ((code>>4)==0x02)
+    {
+      PES_PTS = Get_Timestamp(p-1);  /* presentation time stamp */
+      p += 4;
+    }
+    else if (code!=0x0f)
+      return 0;
+  }
+
+  ld->Rdptr = p;
+  return ld->Rdptr <= ld->Rdmax;
+}
+
+/* Packet_Header() for a header that crosses the end of the input buffer */
+static int Packet_Header_Bytewise()
+{
+  unsigned int code;
+  int n;
+
+  PES_PTS = PES_DTS = -1;
+
+  code = Header_Word();             /* packet_length */
+  ld->Rdmax = ld->Rdptr + code;
+
+  code = Header_Byte();
+
+  if((code>>6)==0x02)
+  {
+    /* ISO/IEC 13818-1 PES packet header */
+    code = Header_Byte();  /* PTS_DTS_flags ... */
+    n = Header_Byte();     /* PES_header_data_length */
+    if (code & 0x80)
+    {
+      PES_PTS = Read_Timestamp(Header_Byte());
+      n -= 5;
+      if (code & 0x40)
       {
-        if(code>=0x40)
+        PES_DTS = Read_Timestamp(Header_Byte());
+        n -= 5;
+      }
+      if (n<0)
+        return 0;
+    }
+    ld->Rdptr += n;
+  }
+  else
+  {
+    /* ISO/IEC 11172-1 packet header: stuffing bytes */
+    while (code==0xff && ld->Rdptr < ld->Rdmax)
+      code = Header_Byte();
+
+    if ((code>>6)==0x01)
+    {
+      /* skip STD_buffer_scale and STD_buffer_size */
+      ld->Rdptr++;
+      code = Header_Byte();
+    }
+
+    if ((code>>4)==0x03)
+    {
+      /* presentation and decoding time stamps */
+      PES_PTS = Read_Timestamp(code);
+      PES_DTS = Read_Timestamp(Header_Byte());
+    }
+    else if ((code>>4)==0x02)
+      PES_PTS = Read_Timestamp(code);  /* presentation time stamp */
+    else if (code!=0x0f)
+      return 0;
+  }
+
+  return ld->Rdptr <= ld->Rdmax;
+}
+
+/* the 33-bit PTS or DTS field in the five bytes at p */
+static long long Get_Timestamp(p)
+unsigned char *p;
+{
+  long long ts;
+
+  ts = (long long)((p[0]>>1) & 0x07) << 30;
+  ts |= (long long)(((p[1]<<8) | p[2])>>1) << 15;
+  ts |= ((p[3]<<8) | p[4])>>1;
+  return ts;
+}
+
+/* the same, read a byte at a time after its first byte */
+static long long Read_Timestamp(first)
+int first;
+{
+  unsigned char b[5];
+  int i;
+
+  b[0] = first;
+  for (i=1; i<5; i++)
+    b[i] = Header_Byte();
+  return Get_Timestamp(b);
+}
+
+/* queue the time stamps of the PES header just parsed for the video
+   packet whose payload starts at Pktbase */
+static void Add_Timestamp()
+{
+  struct timestamp *t;
+
+  if (PES_PTS<0)
+    return;
+
+  /* the oldest were never claimed */
+  if (ld->Timestamps==TIMESTAMPS)
+  {
+    memmove(ld->Timestamp,ld->Timestamp+1,(TIMESTAMPS-1)*sizeof(struct timestamp));
+    ld->Timestamps--;
+  }
+
+  t = &ld->Timestamp[ld->Timestamps++];
+  t->Offset = ld->Pktbase;
+  t->PTS = PES_PTS;
+  t->DTS = PES_DTS;
+  PES_PTS = PES_DTS = -1;
+}
+
+/* time stamps of the picture whose start code has just been read: those
+ * of the video packet in which the start code begins (ISO/IEC 13818-1
+ * section 2.7.5), or -1. Each is used once, and those of earlier packets
+ * without a picture are dropped.
+ */
+void Picture_Timestamps(pts,dts)
+long long *pts, *dts;
+{
+  long es;
+  int i;
+
+  *pts = *dts = -1;
+
+  if (!System_Stream_Flag)
+    return;
+
+  /* the elementary stream is contiguous: count back from Rdptr, which
+     may already be in a later packet than the start code */
+  es = ld->Pktbase + Bitstream_Offset(ld->Rdptr) - (ld->Incnt>>3) - 4 - ld->Pktdata;
+
+  for (i=ld->Timestamps; i>0 && ld->Timestamp[i-1].Offset>es; i--)
+    ;
+  if (i==0)
+    return;
+
+  *pts = ld->Timestamp[i-1].PTS;
+  *dts = ld->Timestamp[i-1].DTS;
+
+  ld->Timestamps -= i;
+  memmove(ld->Timestamp,ld->Timestamp+i,ld->Timestamps*sizeof(struct timestamp));
+}
+
+/* no more video: continue with an endless run of sequence end codes */
+static void End_Of_Stream()
+{
+  ld->Filepos += ld->Rdptr - ld->Rdbase;
+  Pad_Buffer(0);
+  ld->Rdbase = ld->Rdptr;
+  ld->Rdmax = ld->Rdend;
+}
+
+/* print the counters of the system layer demultiplexer, if there were
+   errors or with -v */
+void Print_Demux_Statistics()
+{
+  struct demux_stats *d;
+
+  d = &ld->Demux;
+  if (Verbose_Flag==NO_LAYER && !d->Sync_Errors && !d->Header_Errors
+      && !d->Dropped && !d->Continuity_Errors)
+    return;
+
+  printf("system layer: %ld video packets, %ld other packets skipped\n",
+    d->Packets,d->Skipped);
+  printf("  sync errors %ld, header errors %ld\n",d->Sync_Errors,d->Header_Errors);
+  if (System_Stream_Flag==TRANSPORT_STREAM)
+    printf("  dropped %ld (error/scrambled/duplicate), continuity errors %ld\n",
+      d->Dropped,d->Continuity_Errors);
+}
+
+
+/* MPEG-2 transport stream demultiplexer (ISO/IEC 13818-1 section 2.4.3)
+ *
+ * Like Next_Packet(), point Rdptr..Rdmax at the next span of video data:
+ * the payload of the next transport packet of the video PID, after its
+ * header, adaptation field and, where a PES packet starts, PES header.
+ * The payload is read where it lies, in the input buffer.
+ * Unless -p selects it, the video PID is the first MPEG-1/2 video stream
+ * in the program map table of the first program in the PAT (both are
+ * expected to fit into one transport packet). Packets with errors or
+ * scrambled payload are dropped, duplicates too; continuity counter
+ * gaps are reported and left to the decoder's resynchronization.
+ */
+static void Next_Transport_Packet()
+{
+  unsigned char *p;
+  unsigned int code;
+  int pid, flags, cc, n;
+  long pos, end;
+
+  for (;;)
+  {
+    pos = Bitstream_Offset(ld->Rdptr);
+    if (Get_Byte()!=TRANSPORT_SYNC_BYTE)
+    {
+      /* end of file: the sequence end code padding holds no sync bytes */
+      if (Bitstream_Padding())
+      {
+        End_Of_Stream();
+        return;
+      }
+
+      if (!Sync_Lost)
+      {
+        ld->Demux.Sync_Errors++;
+        if (!Quiet_Flag)
+          fprintf(stderr,"transport stream sync lost at byte %ld\n",pos);
+      }
+      Sync_Lost = SYNC_CONFIRM;
+      continue;
+    }
+
+    /* after a loss of sync the byte may be a 0x47 within a packet: take
+       it for a packet start once the next two packets start with sync
+       bytes too, looked at in place if they are in the buffer, else by
+       skipping the packets in between */
+    if (Sync_Lost)
+    {
+      if (ld->Rdptr + 2*TRANSPORT_PACKET_SIZE-1 < ld->Rdend)
+      {
+        if (ld->Rdptr[TRANSPORT_PACKET_SIZE-1]!=TRANSPORT_SYNC_BYTE
+            || ld->Rdptr[2*TRANSPORT_PACKET_SIZE-1]!=TRANSPORT_SYNC_BYTE)
         {
-          fprintf(stderr,"Error in packet header\n");
-          exit(1);
+          Sync_Lost = SYNC_CONFIRM;
+          continue;
         }
-        /* skip presentation and decoding time stamps */
-        ld->Rdptr += 9;
+        Sync_Lost = 0;
       }
-      else if(code>=0x20)
+      else if (--Sync_Lost)
       {
-        /* skip presentation time stamps */
-        ld->Rdptr += 4;
+        ld->Rdptr += TRANSPORT_PACKET_SIZE-1;
+        continue;
       }
-      else if(code!=0x0f)
+    }
+    end = pos + TRANSPORT_PACKET_SIZE;
+
+    /* the header is parsed in place if the packet is in the buffer;
+       skip adaptation_field() */
+    if (HEADER_FITS(TRANSPORT_PACKET_SIZE-1))
+    {
+      p = ld->Rdptr;
+      code = (p[0]<<8) | p[1];
+      flags = p[2];
+      ld->Rdptr += 3;
+      if (flags & 0x20)
+        ld->Rdptr += 1 + p[3];
+    }
+    else
+    {
+      code = Get_Word();
+      flags = Get_Byte();
+      if (flags & 0x20)
       {
-        fprintf(stderr,"Error in packet header\n");
-        exit(1);
+        n = Get_Byte();
+        ld->Rdptr += n;
       }
-      return;
-    case ISO_END_CODE: /* end */
-      /* simulate a buffer full of sequence end codes */
-      l = 0;
-      while (l<2048)
+    }
+    pid = code & 0x1fff;
+
+    /* drop packets with transport_error_indicator, scrambled or no payload */
+    if ((code & 0x8000) || (flags & 0xc0) || !(flags & 0x10) || Bytes_Left(end)<=0)
+    {
+      if (pid==ld->Pid && (flags & 0x10))
+        ld->Demux.Dropped++;
+      ld->Rdptr += Bytes_Left(end);
+      continue;
+    }
+
+    if (pid==ld->Pid)
+    {
+      cc = flags & 0x0f;
+      if (cc==ld->Cc)
       {
-        ld->Rdbfr[l++] = SEQUENCE_END_CODE>>24;
-        ld->Rdbfr[l++] = SEQUENCE_END_CODE>>16;
-        ld->Rdbfr[l++] = SEQUENCE_END_CODE>>8;
-        ld->Rdbfr[l++] = SEQUENCE_END_CODE&0xff;
+        /* duplicate packet */
+        ld->Demux.Dropped++;
+        ld->Rdptr += Bytes_Left(end);
+        continue;
       }
-      ld->Rdptr = ld->Rdbfr;
-      ld->Rdmax = ld->Rdbfr + 2048;
-      return;
-    default:
-      if(code>=SYSTEM_START_CODE)
+      if (ld->Cc>=0 && cc!=((ld->Cc+1)&0x0f))
       {
-        /* skip system headers and non-video packets*/
-        code = Get_Word();
-        ld->Rdptr += code;
+        ld->Demux.Continuity_Errors++;
+        if (!Quiet_Flag)
+          fprintf(stderr,"continuity error on PID %d at byte %ld\n",pid,pos);
       }
-      else
+      ld->Cc = cc;
+      ld->Demux.Packets++;
+
+      /* payload_unit_start_indicator */
+      if ((code & 0x4000) && !Transport_PES_Header(end))
       {
-        fprintf(stderr,"Unexpected startcode %08x in system layer\n",code);
-        exit(1);
+        ld->Demux.Header_Errors++;
+        ld->Rdptr += Bytes_Left(end);
+        continue;
       }
-      break;
+
+      n = Bytes_Left(end);
+      if (n<=0)
+      {
+        ld->Rdptr += n;
+        continue;
+      }
+
+      /* see Next_Packet() */
+      ld->Prevpos = ld->Pktpos;
+      ld->Prevbase = ld->Pktbase;
+      ld->Pktbase += Bitstream_Offset(ld->Rdmax) - ld->Pktdata;
+      ld->Pktpos = pos;
+
+      ld->Rdmax = ld->Rdptr + n;
+      ld->Pktdata = Bitstream_Offset(ld->Rdptr);
+      Add_Timestamp();
+      return;
+    }
+
+    if (ld->Pid<0 && (code & 0x4000))
+    {
+      if (pid==PAT_PID)
+        Program_Association(end);
+      else if (pid==ld->Pmt_Pid)
+        Program_Map(end);
     }
+
+    ld->Demux.Skipped++;
+    ld->Rdptr += Bytes_Left(end);
   }
 }
 
+/* bytes of the current transport packet from Rdptr up to End */
+static int Bytes_Left(end)
+long end;
+{
+  return (int)(end - Bitstream_Offset(ld->Rdptr));
+}
 
-
-void Flush_Buffer32()
+/* skip the PES packet header at the start of a transport packet payload,
+   noting its time stamps; returns 0 if there is none */
+static int Transport_PES_Header(end)
+long end;
 {
-  int Incnt;
+  unsigned char *p;
+  int n, flags, left;
 
-  ld->Bfr = 0;
+  /* in place if the rest of the packet is in the buffer */
+  left = Bytes_Left(end);
+  if (!HEADER_FITS(left))
+    return Transport_PES_Header_Bytewise(end);
 
-  Incnt = ld->Incnt;
-  Incnt -= 32;
+  PES_PTS = PES_DTS = -1;
 
-  if (System_Stream_Flag && (ld->Rdptr >= ld->Rdmax-4))
+  p = ld->Rdptr;
+  if (left<9 || p[0]!=0x00 || p[1]!=0x00 || p[2]!=0x01)
   {
-    while (Incnt <= 24)
+    if (!Quiet_Flag)
+      fprintf(stderr,"missing PES header on PID %d\n",ld->Pid);
+    return 0;
+  }
+
+  /* stream_id, PES_packet_length; MPEG-2 PES header: flags and
+     PES_header_data_length */
+  if ((p[6]>>6)==0x02)
+  {
+    flags = p[7];
+    n = p[8];
+    p += 9;
+    left -= 9;
+    if ((flags & 0x80) && n>=5 && left>=5)
     {
-      if (ld->Rdptr >= ld->Rdmax)
-        Next_Packet();
-      ld->Bfr |= Get_Byte() << (24 - Incnt);
-      Incnt += 8;
+      PES_PTS = Get_Timestamp(p);
+      p += 5;
+      n -= 5;
+      left -= 5;
+      if ((flags & 0x40) && n>=5 && left>=5)
+      {
+        PES_DTS = Get_Timestamp(p);
+        p += 5;
+        n -= 5;
+      }
     }
+    p += n;
   }
   else
   {
-    while (Incnt <= 24)
+    p += 7;
+    if (!Quiet_Flag)
+      fprintf(stderr,"unsupported PES header on PID %d\n",ld->Pid);
+  }
+
+  ld->Rdptr = p;
+  return 1;
+}
+
+/* Transport_PES_Header() for a packet that crosses the end of the input
+   buffer */
+static int Transport_PES_Header_Bytewise(end)
+long end;
+{
+  int n, flags;
+
+  PES_PTS = PES_DTS = -1;
+
+  if (Bytes_Left(end)<9 || Get_Byte()!=0x00 || Get_Byte()!=0x00 || Get_Byte()!=0x01)
+  {
+    if (!Quiet_Flag)
+      fprintf(stderr,"missing PES header on PID %d\n",ld->Pid);
+    return 0;
+  }
+
+  Get_Byte();  /* stream_id */
+  Get_Word();  /* PES_packet_length */
+
+  /* MPEG-2 PES header: flags and PES_header_data_length */
+  if ((Get_Byte()>>6)==0x02)
+  {
+    flags = Get_Byte();
+    n = Get_Byte();
+    if ((flags & 0x80) && n>=5 && Bytes_Left(end)>=5)
+    {
+      PES_PTS = Read_Timestamp(Get_Byte());
+      n -= 5;
+      if ((flags & 0x40) && n>=5 && Bytes_Left(end)>=5)
+      {
+        PES_DTS = Read_Timestamp(Get_Byte());
+        n -= 5;
+      }
+    }
+    ld->Rdptr += n;
+  }
+  else if (!Quiet_Flag)
+    fprintf(stderr,"unsupported PES header on PID %d\n",ld->Pid);
+
+  return 1;
+}
+
+/* program_association_section(): the first program's PMT PID */
+static void Program_Association(end)
+long end;
+{
+  int n, len, program, pid;
+
+  n = Get_Byte();  /* pointer_field */
+  ld->Rdptr += n;
+
+  if (Bytes_Left(end)<8 || Get_Byte()!=0x00)  /* table_id */
+    return;
+
+  len = Get_Word() & 0x0fff;  /* section_length */
+  Get_Word();                 /* transport_stream_id */
+  Get_Byte();                 /* version_number, current_next_indicator */
+  Get_Word();                 /* section_number, last_section_number */
+  len -= 5 + 4;               /* up to CRC_32 */
+
+  while (len>=4 && Bytes_Left(end)>=4)
+  {
+    program = Get_Word();
+    pid = Get_Word() & 0x1fff;
+    len -= 4;
+
+    /* program_number 0 is the network PID */
+    if (program!=0)
     {
-      if (ld->Rdptr >= ld->Rdbfr+2048)
-        Fill_Buffer();
-      ld->Bfr |= *ld->Rdptr++ << (24 - Incnt);
-      Incnt += 8;
+      ld->Pmt_Pid = pid;
+      return;
     }
   }
-  ld->Incnt = Incnt;
+}
+
+/* TS_program_map_section(): the first MPEG-1 or MPEG-2 video stream */
+static void Program_Map(end)
+long end;
+{
+  int n, len, type, pid;
+
+  n = Get_Byte();  /* pointer_field */
+  ld->Rdptr += n;
+
+  if (Bytes_Left(end)<12 || Get_Byte()!=0x02)  /* table_id */
+    return;
+
+  len = Get_Word() & 0x0fff;  /* section_length */
+  Get_Word();                 /* program_number */
+  Get_Byte();                 /* version_number, current_next_indicator */
+  Get_Word();                 /* section_number, last_section_number */
+  Get_Word();                 /* PCR_PID */
+  n = Get_Word() & 0x0fff;    /* program_info_length */
+  ld->Rdptr += n;
+  len -= 9 + n + 4;
 
-#ifdef VERIFY 
-  ld->Bitcnt += 32;
-#endif /* VERIFY */
+  while (len>=5 && Bytes_Left(end)>=5)
+  {
+    type = Get_Byte();
+    pid = Get_Word() & 0x1fff;
+    n = Get_Word() & 0x0fff;  /* ES_info_length */
+    ld->Rdptr += n;
+    len -= 5 + n;
+
+    /* stream_type 0x01: ISO/IEC 11172-2, 0x02: ISO/IEC 13818-2 video */
+    if (type==0x01 || type==0x02)
+    {
+      ld->Pid = pid;
+      if (Verbose_Flag>NO_LAYER)
+        printf("transport stream video PID %d\n",pid);
+      return;
+    }
+  }
 }
 
 
-unsigned int Get_Bits32()
+/* the 64-bit bit reservoir always holds at least 32 valid bits */
+void Flush_Buffer32()
 {
-  unsigned int l;
+  Flush_Buffer(32);
+}
 
-  l = Show_Bits(32);
-  Flush_Buffer32();
 
-  return l;
+unsigned int Get_Bits32()
+{
+  return Get_Bits(32);
 }
 
 
@@ -72,14 +72,14 @@ int Sequence_Framenum;
   int d;
   int internal_vbv_delay;
   
-  static int previous_IorP_picture_structure;
-  static int previous_IorP_repeat_first_field;
-  static int previous_IorP_top_field_first;
-  static int previous_vbv_delay;
-  static int previous_bitstream_position;
+  static THREAD_LOCAL int previous_IorP_picture_structure;
+  static THREAD_LOCAL int previous_IorP_repeat_first_field;
+  static THREAD_LOCAL int previous_IorP_top_field_first;
+  static THREAD_LOCAL int previous_vbv_delay;
+  static THREAD_LOCAL int previous_bitstream_position;
 
-  static double previous_Bn;
-  static double E;      /* maximum quantization error or mismatch */
+  static THREAD_LOCAL double previous_Bn;
+  static THREAD_LOCAL double E;      /* maximum quantization error or mismatch */
 
   
 
@@ -194,8 +194,7 @@ int Sequence_Framenum;
             if(previous_IorP_picture_structure!=FRAME_PICTURE 
               || previous_IorP_repeat_first_field==0)
               I = 2*T - T;  /* a net of one field period */ 
-            else if(previous_IorP_picture_structure==FRAME_PICTURE 
-              && previous_IorP_repeat_first_field==1)
+            else /* FRAME_PICTURE with repeat_first_field */
               I = 3*T - T;  /* a net of two field periods */
           }
         }